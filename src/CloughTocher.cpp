@@ -0,0 +1,257 @@
+//  CloughTocher.cpp
+//  delta_xcode
+//
+
+#include "CloughTocher.hpp"
+#include <algorithm>
+#include <unordered_set>
+
+// Solves the n x n system a x = b in place (b receives x) by elimination with partial pivoting.
+// Returns false if a pivot is negligible against the largest diagonal entry.
+static bool solveSmall(double* a, double* b, int n)
+{
+    double scale(0);
+    for (int i = 0; i < n; i++){
+        scale = std::max(scale, std::fabs(a[i * n + i]));
+    }
+    for (int col = 0; col < n; col++){
+        int pivot = col;
+        for (int row = col + 1; row < n; row++){
+            if (std::fabs(a[row * n + col]) > std::fabs(a[pivot * n + col])) pivot = row;
+        }
+        if (!(std::fabs(a[pivot * n + col]) > 1e-12 * scale)) return false;
+        if (pivot != col){
+            for (int k = 0; k < n; k++){
+                std::swap(a[col * n + k], a[pivot * n + k]);
+            }
+            std::swap(b[col], b[pivot]);
+        }
+        for (int row = col + 1; row < n; row++){
+            double factor = a[row * n + col] / a[col * n + col];
+            for (int k = col; k < n; k++){
+                a[row * n + k] -= factor * a[col * n + k];
+            }
+            b[row] -= factor * b[col];
+        }
+    }
+    for (int row = n - 1; row >= 0; row--){
+        for (int k = row + 1; k < n; k++){
+            b[row] -= a[row * n + k] * b[k];
+        }
+        b[row] /= a[row * n + row];
+    }
+    return true;
+}
+
+static inline double cross(const MeshPoint& a, const MeshPoint& b)
+{
+    return a.x_ * b.y_ - a.y_ * b.x_;
+}
+
+// Middle coefficient of the sub-triangle (pa, pb, c) next to edge pa -> pb, chosen so that the
+// derivative across the edge, along its normal, is linear on the edge. That derivative only
+// depends on the data on the edge, so both triangles sharing it agree and the surface is C1.
+static double edgeCoefficient(const MeshPoint& pa, const MeshPoint& pb, const MeshPoint& c,
+                              double fa, double eab, double eba, double fb, double qa, double qb)
+{
+    MeshPoint e(pb.x_ - pa.x_, pb.y_ - pa.y_);
+    MeshPoint h(c.x_ - pa.x_, c.y_ - pa.y_);
+    MeshPoint n(-e.y_, e.x_);
+    // the normal in barycentric directions of the sub-triangle: n = db (pb - pa) + dc (c - pa)
+    double db = cross(n, h) / cross(e, h);
+    double dc = cross(n, e) / cross(h, e);
+    double da = -db - dc;
+    double ends = (da * fa + db * eab + dc * qa) + (da * eba + db * fb + dc * qb);
+    return (ends / 2 - da * eab - db * eba) / dc;
+}
+
+CloughTocher::CloughTocher(Mesh& mesh, unsigned int nthreads)
+    :mesh_(mesh), generation_(0)
+{
+    update(nthreads);
+}
+
+void CloughTocher::update(unsigned int nthreads)
+{
+    TraceSpan span("CloughTocher::update");
+    mesh_.buildVertexIndex();
+    if (nthreads == 0) nthreads = std::max(1u, std::thread::hardware_concurrency());
+    size_t nv = mesh_.size();
+    size_t nt = mesh_.numTriag();
+    // runs range(begin, end) on threads over [0, n); not worth a thread for a few hundred items
+    auto parallelFor = [nthreads](size_t n, std::function<void(size_t, size_t)> range){
+        size_t nk = std::max(size_t(1), std::min(size_t(nthreads), n / 1024));
+        size_t chunk = (n + nk - 1) / nk;
+        std::vector<std::thread> workers;
+        for (size_t k = 0; k < nk; k++){
+            workers.push_back(std::thread(range, std::min(n, k * chunk), std::min(n, (k + 1) * chunk)));
+        }
+        for (size_t k = 0; k < workers.size(); k++){
+            workers[k].join();
+        }
+    };
+
+    grad_.resize(nv);
+    parallelFor(nv, [&](size_t begin, size_t end){
+        for (size_t i = begin; i < end; i++){
+            grad_[i] = fitGradient(i);
+        }
+    });
+    generation_ = mesh_.generation();
+    coef_.resize(STRIDE * nt);
+    parallelFor(nt, [&](size_t begin, size_t end){
+        for (size_t j = begin; j < end; j++){
+            cacheTriag(3 * j);
+        }
+    });
+}
+
+MeshPoint CloughTocher::gradient(size_t i)
+{
+    return grad_[i];
+}
+
+MeshPoint CloughTocher::fitGradient(size_t i)
+{
+    std::vector<size_t> ring = mesh_.neighborsOfVertex(i);
+    if (ring.empty()) return MeshPoint(0, 0); // duplicate point, not in the triangulation
+    if (ring.size() < 6){
+        // an exact fit through five points can be wild (hull stars); take the second ring as well
+        std::unordered_set<size_t> seen(ring.begin(), ring.end());
+        seen.insert(i);
+        size_t first = ring.size();
+        for (size_t k = 0; k < first; k++){
+            std::vector<size_t> next = mesh_.neighborsOfVertex(ring[k]);
+            for (size_t j = 0; j < next.size(); j++){
+                if (seen.insert(next[j]).second) ring.push_back(next[j]);
+            }
+        }
+    }
+    VecDoub& val = mesh_.values();
+    MeshPoint p = mesh_.vertex(i);
+    double h(0);
+    for (size_t k = 0; k < ring.size(); k++){
+        MeshPoint q = mesh_.vertex(ring[k]);
+        h += std::sqrt(delaunator::dist(p.x_, p.y_, q.x_, q.y_));
+    }
+    h /= ring.size();
+    if (!(h > 0)) return MeshPoint(0, 0);
+
+    // weighted normal equations for f(q) - f(p) ~ g . d + d^T H d / 2, in units of h so they
+    // stay well scaled; closer neighbors count more
+    double a5[25] = {0}, b5[5] = {0}, a2[4] = {0}, b2[2] = {0};
+    for (size_t k = 0; k < ring.size(); k++){
+        MeshPoint q = mesh_.vertex(ring[k]);
+        double u = (q.x_ - p.x_) / h, v = (q.y_ - p.y_) / h;
+        double r2 = u * u + v * v;
+        if (!(r2 > 0)) continue;
+        double w = 1 / r2;
+        double row[5] = {u, v, u * u / 2, u * v, v * v / 2};
+        double df = val[ring[k]] - val[i];
+        for (int m = 0; m < 5; m++){
+            for (int l = 0; l < 5; l++){
+                a5[m * 5 + l] += w * row[m] * row[l];
+            }
+            b5[m] += w * row[m] * df;
+        }
+        for (int m = 0; m < 2; m++){
+            for (int l = 0; l < 2; l++){
+                a2[m * 2 + l] += w * row[m] * row[l];
+            }
+            b2[m] += w * row[m] * df;
+        }
+    }
+    if (solveSmall(a5, b5, 5)) return MeshPoint(b5[0] / h, b5[1] / h);
+    // points on a line (or too few): a plane is the best that can be fit
+    if (solveSmall(a2, b2, 2)) return MeshPoint(b2[0] / h, b2[1] / h);
+    return MeshPoint(0, 0);
+}
+
+void CloughTocher::cacheTriag(size_t t)
+{
+    std::vector<size_t> corners = mesh_.pointsOfTriag(t); // coordinate indices {2 v, 2 v + 1, ...}
+    size_t v[3];
+    MeshPoint p[3];
+    double f[3];
+    VecDoub& val = mesh_.values();
+    for (int k = 0; k < 3; k++){
+        v[k] = corners[2 * k] / 2;
+        p[k] = mesh_.vertex(v[k]);
+        f[k] = val[v[k]];
+    }
+    double* out = &coef_[STRIDE * (t / 3)];
+
+    // barycentric map: lambda_0 = out[0] + out[1] x + out[2] y, lambda_1 likewise from out[3]
+    // and lambda_2 = 1 - lambda_0 - lambda_1
+    double inv_det = 1 / ((p[0].x_ - p[2].x_) * (p[1].y_ - p[2].y_) - (p[1].x_ - p[2].x_) * (p[0].y_ - p[2].y_));
+    out[1] = inv_det * (p[1].y_ - p[2].y_);
+    out[2] = inv_det * (p[2].x_ - p[1].x_);
+    out[0] = -(out[1] * p[2].x_ + out[2] * p[2].y_);
+    out[4] = inv_det * (p[2].y_ - p[0].y_);
+    out[5] = inv_det * (p[0].x_ - p[2].x_);
+    out[3] = -(out[4] * p[2].x_ + out[5] * p[2].y_);
+
+    // Bezier ordinates of the three cubics, named by the vertex (0, 1, 2) or centroid (c) they
+    // sit closest to: f on the vertices, e_ij on the edges, q_i and r_i on the inner edges, m_k in
+    // the middle of the piece opposite vertex k, s on the centroid
+    MeshPoint c((p[0].x_ + p[1].x_ + p[2].x_) / 3, (p[0].y_ + p[1].y_ + p[2].y_) / 3);
+    auto ahead = [&](int i, const MeshPoint& to){
+        return f[i] + (grad_[v[i]].x_ * (to.x_ - p[i].x_) + grad_[v[i]].y_ * (to.y_ - p[i].y_)) / 3;
+    };
+    double e01 = ahead(0, p[1]), e10 = ahead(1, p[0]);
+    double e12 = ahead(1, p[2]), e21 = ahead(2, p[1]);
+    double e20 = ahead(2, p[0]), e02 = ahead(0, p[2]);
+    double q0 = ahead(0, c), q1 = ahead(1, c), q2 = ahead(2, c);
+    double m0 = edgeCoefficient(p[1], p[2], c, f[1], e12, e21, f[2], q1, q2);
+    double m1 = edgeCoefficient(p[2], p[0], c, f[2], e20, e02, f[0], q2, q0);
+    double m2 = edgeCoefficient(p[0], p[1], c, f[0], e01, e10, f[1], q0, q1);
+    // C1 across the inner edges and at the centroid
+    double r0 = (q0 + m1 + m2) / 3;
+    double r1 = (q1 + m2 + m0) / 3;
+    double r2 = (q2 + m0 + m1) / 3;
+    double s = (r0 + r1 + r2) / 3;
+    double bezier[19] = {f[0], f[1], f[2], e01, e10, e12, e21, e20, e02, q0, q1, q2, m0, m1, m2, r0, r1, r2, s};
+    std::copy(bezier, bezier + 19, out + 6);
+}
+
+void CloughTocher::checkGeneration()
+{
+    try {
+        if (mesh_.generation() != generation_){
+            throw ExitException(13);
+        }
+    } catch (ExitException& e) {
+        e.what();
+    }
+}
+
+double CloughTocher::interpInTriag(MeshPoint p, size_t t)
+{
+    checkGeneration();
+    const double* a = &coef_[STRIDE * (t / 3)];
+    const double* c = a + 6;
+    double l0 = a[0] + a[1] * p.x_ + a[2] * p.y_;
+    double l1 = a[3] + a[4] * p.x_ + a[5] * p.y_;
+    double l2 = 1 - l0 - l1;
+    // the piece is the one opposite the smallest coordinate, which is zero on it; coordinates on
+    // the piece are (b0, b1, b2) on the vertices and b3 on the centroid
+    double low = std::min(l0, std::min(l1, l2));
+    double b0 = l0 - low, b1 = l1 - low, b2 = l2 - low, b3 = 3 * low;
+    enum {F0, F1, F2, E01, E10, E12, E21, E20, E02, Q0, Q1, Q2, M0, M1, M2, R0, R1, R2, S};
+    return b0 * b0 * b0 * c[F0] + b1 * b1 * b1 * c[F1] + b2 * b2 * b2 * c[F2] + b3 * b3 * b3 * c[S]
+         + 3 * (b0 * b0 * (b1 * c[E01] + b2 * c[E02] + b3 * c[Q0])
+              + b1 * b1 * (b0 * c[E10] + b2 * c[E12] + b3 * c[Q1])
+              + b2 * b2 * (b0 * c[E20] + b1 * c[E21] + b3 * c[Q2])
+              + b3 * b3 * (b0 * c[R0] + b1 * c[R1] + b2 * c[R2]))
+         + 6 * b3 * (b1 * b2 * c[M0] + b2 * b0 * c[M1] + b0 * b1 * c[M2]);
+}
+
+double CloughTocher::interp(MeshPoint p, size_t init)
+{
+    return interpInTriag(p, mesh_.locate(p, init));
+}
+
+size_t CloughTocher::memoryUsage()
+{
+    return grad_.capacity() * sizeof(MeshPoint) + coef_.capacity() * sizeof(double);
+}
@@ -0,0 +1,88 @@
+//  CloughTocher.hpp
+//  delta_xcode
+//
+//  C1 piecewise cubic interpolation on a Mesh, with cached coefficients per triangle
+//
+
+#ifndef clough_tocher_h
+#define clough_tocher_h
+
+#include "Mesh.hpp"
+
+/**
+ *\brief Clough-Tocher interpolation of the values of a Mesh
+ *\details Every triangle is split at its centroid into three, and the interpolant is a cubic on each
+ *          piece. It matches the values and the gradients at the vertices, and the derivative
+ *          across every edge varies linearly along it, so the surface is C1 over the whole domain
+ *          and reproduces quadratics exactly. Where linear interpolation converges with h^2, this
+ *          converges with h^3, so a much coarser mesh gives the same accuracy on smooth fields.
+ *
+ *          The gradients are estimated on construction from a weighted least-squares quadratic fit
+ *          over each vertex star, and the 19 Bezier coefficients of every triangle are computed
+ *          once and cached together with its barycentric map. A query is then one locate plus a
+ *          fixed evaluation of a cubic, without touching the mesh coordinates again.
+ *
+ *          The cache belongs to the values and the triangles it was built from. Call update after
+ *          changing the values, and after Mesh::rebuild or Mesh::moveVertices; queries on a
+ *          mesh whose triangles changed since (see Mesh::generation) exit with an error.
+ */
+class CloughTocher
+{
+public:
+    /**
+     *\brief Estimates the gradients and caches the coefficients of every triangle
+     *\param nthreads Number of threads; 0 uses all hardware threads
+     *\note Builds the vertex index of the mesh.
+     */
+    CloughTocher(Mesh& mesh, unsigned int nthreads = 0);
+
+    /**
+     *\brief Recomputes the gradients and coefficients from the current values and triangles
+     */
+    void update(unsigned int nthreads = 0);
+
+    /**
+     *\brief Estimated gradient at vertex i
+     */
+    MeshPoint gradient(size_t i);
+
+    /**
+     *\brief Interpolated value at p in a known triangle t
+     */
+    double interpInTriag(MeshPoint p, size_t t);
+
+    /**
+     *\brief Interpolated value at p, searching from triangle init; see Mesh::interp
+     */
+    double interp(MeshPoint p, size_t init);
+
+    /**
+     *\brief Bytes held by the gradients and the coefficient cache
+     */
+    size_t memoryUsage();
+
+private:
+    /**
+     *\brief Gradient at vertex i from a quadratic fit to the values around it
+     */
+    MeshPoint fitGradient(size_t i);
+
+    /**
+     *\brief Fills the cache entry of triangle t (first half edge)
+     */
+    void cacheTriag(size_t t);
+
+    /**
+     *\brief Exits if the triangles of the mesh changed since update
+     */
+    void checkGeneration();
+
+    static const size_t STRIDE = 25; // 6 for the barycentric map, 19 Bezier coefficients
+
+    Mesh& mesh_;
+    size_t generation_;              // of the mesh when the cache was built
+    std::vector<MeshPoint> grad_;
+    VecDoub coef_;                   // STRIDE per triangle
+};
+
+#endif /* clough_tocher_h */
@@ -0,0 +1,322 @@
+//  Decimator.cpp
+//  delta_xcode
+//
+
+#include "Decimator.hpp"
+
+Decimator::Decimator(VecDoub& coords, VecDoub& val)
+    :coords_(coords), val_(val), orientation_(1), max_error_(0), size_(0)
+{
+    if (val_.size() != coords_.size() /2){
+        try {
+            throw ExitException(1);
+        } catch (ExitException& e) {
+            std::cerr << "Found " << val.size() << " values for ";
+            std::cerr << coords_.size() /2 << " pairs of coordinates." << std::endl;
+            std::cout << e.what() << std::endl;
+        }
+    }
+    delaunator::Delaunator d(coords_);
+    triangles_ = d.triangles;
+    halfedges_ = d.halfedges;
+
+    size_t n = val_.size();
+    size_t ntri = triangles_.size() / 3;
+    inedges_.assign(n, delaunator::INVALID_INDEX);
+    hull_.assign(n, 0);
+    for (size_t e = 0; e < triangles_.size(); e++){
+        inedges_[triangles_[(e % 3 == 2) ? e - 2 : e + 1]] = e;
+        if (halfedges_[e] == delaunator::INVALID_INDEX){
+            hull_[triangles_[e]] = 1; // every hull vertex starts one hull edge
+        }
+    }
+    removed_.assign(n, 0);
+    for (size_t i = 0; i < n; i++){
+        if (inedges_[i] == delaunator::INVALID_INDEX){
+            removed_[i] = 1; // duplicate point, left out of the triangulation
+        } else {
+            size_++;
+        }
+    }
+    dead_.assign(ntri, 0);
+    inside_.resize(ntri);
+    stamp_.assign(n, 0);
+
+    if (ntri > 0){
+        size_t a = triangles_[0], b = triangles_[1], c = triangles_[2];
+        double area = (coords_[2 * b] - coords_[2 * a]) * (coords_[2 * c + 1] - coords_[2 * a + 1])
+                    - (coords_[2 * c] - coords_[2 * a]) * (coords_[2 * b + 1] - coords_[2 * a + 1]);
+        orientation_ = (area < 0) ? -1 : 1;
+    }
+}
+
+size_t Decimator::run(double tol)
+{
+    typedef std::pair<double, std::pair<size_t, size_t> > Entry; // cost, (vertex, stamp)
+    std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry> > queue;
+    for (size_t v = 0; v < val_.size(); v++){
+        if (removed_[v] || hull_[v]) continue;
+        double c = cost(v);
+        if (c <= tol) queue.push(Entry(c, std::make_pair(v, stamp_[v])));
+    }
+
+    size_t count(0);
+    while (!queue.empty()){
+        Entry top = queue.top();
+        queue.pop();
+        size_t v = top.second.first;
+        if (removed_[v] || top.second.second != stamp_[v]) continue; // stale entry
+
+        std::vector<size_t> link;
+        remove(v, link);
+        count++;
+        max_error_ = std::max(max_error_, top.first);
+
+        // the stars of the surrounding vertices changed; queue them again
+        for (size_t k = 0; k < link.size(); k++){
+            size_t u = link[k];
+            stamp_[u]++;
+            if (hull_[u]) continue;
+            double c = cost(u);
+            if (c <= tol) queue.push(Entry(c, std::make_pair(u, stamp_[u])));
+        }
+    }
+    return count;
+}
+
+size_t Decimator::size()
+{
+    return size_;
+}
+
+double Decimator::maxError()
+{
+    return max_error_;
+}
+
+std::vector<size_t> Decimator::kept()
+{
+    std::vector<size_t> out;
+    out.reserve(size_);
+    for (size_t i = 0; i < removed_.size(); i++){
+        if (!removed_[i]) out.push_back(i);
+    }
+    return out;
+}
+
+void Decimator::remaining(VecDoub& coords, VecDoub& val)
+{
+    std::vector<size_t> keep = kept();
+    coords.resize(2 * keep.size());
+    val.resize(keep.size());
+    for (size_t k = 0; k < keep.size(); k++){
+        coords[2 * k]     = coords_[2 * keep[k]];
+        coords[2 * k + 1] = coords_[2 * keep[k] + 1];
+        val[k] = val_[keep[k]];
+    }
+}
+
+void Decimator::star(size_t v, std::vector<size_t>& link, std::vector<size_t>& inner,
+                     std::vector<size_t>& triags)
+{
+    // around v, triangle k is (u_k, v, u_k+1) and its edge u_k+1 -> u_k faces v
+    std::vector<size_t> around, facing;
+    triags.clear();
+    size_t e0 = inedges_[v];
+    size_t e = e0;
+    do {
+        around.push_back(triangles_[e]);
+        facing.push_back((e % 3 == 0) ? e + 2 : e - 1);
+        triags.push_back(e - (e % 3));
+        e = halfedges_[(e % 3 == 2) ? e - 2 : e + 1];
+    } while (e != e0 && e != delaunator::INVALID_INDEX);
+
+    // reversed, the polygon runs in the same orientation as the triangles
+    size_t m = around.size();
+    link.assign(around.rbegin(), around.rend());
+    inner.resize(m);
+    for (size_t j = 0; j < m; j++){
+        inner[j] = facing[(2 * m - 2 - j) % m]; // edge link[j] -> link[j + 1]
+    }
+}
+
+bool Decimator::fillHole(std::vector<size_t>& link, std::vector<size_t>& fill, std::vector<int>& sides)
+{
+    size_t m = link.size();
+    fill.clear();
+    sides.clear();
+    if (m < 3) return false;
+
+    std::vector<size_t> poly; // positions in link still on the polygon
+    for (size_t j = 0; j < m; j++){
+        poly.push_back(j);
+    }
+    while (poly.size() >= 3){
+        size_t np = poly.size();
+        size_t chosen(delaunator::INVALID_INDEX), fallback(delaunator::INVALID_INDEX);
+        for (size_t k = 0; k < np && chosen == delaunator::INVALID_INDEX; k++){
+            size_t a = link[poly[(k + np - 1) % np]];
+            size_t b = link[poly[k]];
+            size_t c = link[poly[(k + 1) % np]];
+            double ax = coords_[2 * a], ay = coords_[2 * a + 1];
+            double bx = coords_[2 * b], by = coords_[2 * b + 1];
+            double cx = coords_[2 * c], cy = coords_[2 * c + 1];
+            double area = ((bx - ax) * (cy - ay) - (cx - ax) * (by - ay)) * orientation_;
+            if (!(area > 0)) continue; // reflex or flat corner
+
+            bool empty_triag = true;
+            bool empty_circle = true;
+            for (size_t l = 0; l < np; l++){
+                size_t p = link[poly[l]];
+                if (p == a || p == b || p == c) continue;
+                double px = coords_[2 * p], py = coords_[2 * p + 1];
+                double s0 = ((bx - ax) * (py - ay) - (px - ax) * (by - ay)) * orientation_;
+                double s1 = ((cx - bx) * (py - by) - (px - bx) * (cy - by)) * orientation_;
+                double s2 = ((ax - cx) * (py - cy) - (px - cx) * (ay - cy)) * orientation_;
+                if (s0 >= 0 && s1 >= 0 && s2 >= 0){
+                    empty_triag = false;
+                    break;
+                }
+                if (delaunator::in_circle(ax, ay, bx, by, cx, cy, px, py)){
+                    empty_circle = false;
+                }
+            }
+            if (!empty_triag) continue;
+            if (empty_circle) chosen = k;
+            else if (fallback == delaunator::INVALID_INDEX) fallback = k; // cocircular ties
+        }
+        if (chosen == delaunator::INVALID_INDEX) chosen = fallback;
+        if (chosen == delaunator::INVALID_INDEX) return false;
+
+        size_t corner[3] = {poly[(chosen + np - 1) % np], poly[chosen], poly[(chosen + 1) % np]};
+        for (int i = 0; i < 3; i++){
+            size_t from = corner[i];
+            size_t to = corner[(i + 1) % 3];
+            fill.push_back(link[from]);
+            sides.push_back(((from + 1) % m == to) ? int(from) : -1);
+        }
+        poly.erase(poly.begin() + chosen);
+        if (np == 3) break;
+    }
+    return true;
+}
+
+double Decimator::cost(size_t v)
+{
+    std::vector<size_t> link, inner, triags, fill;
+    std::vector<int> sides;
+    star(v, link, inner, triags);
+    if (!fillHole(link, fill, sides)) return std::numeric_limits<double>::infinity();
+
+    double err = 0;
+    double bary[3];
+    std::vector<size_t> points(1, v);
+    for (size_t k = 0; k < triags.size(); k++){
+        std::vector<size_t>& in = inside_[triags[k] / 3];
+        points.insert(points.end(), in.begin(), in.end());
+    }
+    for (size_t k = 0; k < points.size(); k++){
+        size_t p = points[k];
+        size_t t = locateIn(p, fill);
+        double f = interpIn(p, fill[t], fill[t + 1], fill[t + 2], bary);
+        err = std::max(err, std::fabs(f - val_[p]));
+    }
+    return err;
+}
+
+void Decimator::remove(size_t v, std::vector<size_t>& link)
+{
+    std::vector<size_t> inner, triags, fill;
+    std::vector<int> sides;
+    star(v, link, inner, triags);
+    fillHole(link, fill, sides);
+    size_t m = link.size();
+
+    std::vector<size_t> outer(m);
+    for (size_t j = 0; j < m; j++){
+        outer[j] = halfedges_[inner[j]];
+    }
+    std::vector<size_t> points(1, v);
+    for (size_t k = 0; k < m; k++){
+        std::vector<size_t>& in = inside_[triags[k] / 3];
+        points.insert(points.end(), in.begin(), in.end());
+        in.clear();
+    }
+
+    // m - 2 new triangles go into the first slots of the star; the last two are freed
+    std::vector<size_t> pending; // diagonals waiting for their twin
+    for (size_t k = 0; k + 2 < m; k++){
+        size_t t = triags[k];
+        for (size_t i = 0; i < 3; i++){
+            triangles_[t + i] = fill[3 * k + i];
+        }
+        for (size_t i = 0; i < 3; i++){
+            size_t h = t + i;
+            int side = sides[3 * k + i];
+            if (side >= 0){
+                halfedges_[h] = outer[side];
+                if (outer[side] != delaunator::INVALID_INDEX) halfedges_[outer[side]] = h;
+            } else {
+                size_t from = triangles_[h];
+                size_t to = triangles_[(i == 2) ? t : h + 1];
+                size_t twin = delaunator::INVALID_INDEX;
+                for (size_t l = 0; l < pending.size(); l++){
+                    size_t g = pending[l];
+                    size_t g_to = triangles_[(g % 3 == 2) ? g - 2 : g + 1];
+                    if (triangles_[g] == to && g_to == from){
+                        twin = g;
+                        pending.erase(pending.begin() + l);
+                        break;
+                    }
+                }
+                if (twin == delaunator::INVALID_INDEX){
+                    pending.push_back(h);
+                } else {
+                    halfedges_[h] = twin;
+                    halfedges_[twin] = h;
+                }
+            }
+            inedges_[fill[3 * k + (i + 1) % 3]] = h;
+        }
+    }
+    dead_[triags[m - 2] / 3] = 1;
+    dead_[triags[m - 1] / 3] = 1;
+
+    removed_[v] = 1;
+    inedges_[v] = delaunator::INVALID_INDEX;
+    size_--;
+
+    for (size_t k = 0; k < points.size(); k++){
+        size_t t = locateIn(points[k], fill);
+        inside_[triags[t / 3] / 3].push_back(points[k]);
+    }
+}
+
+double Decimator::interpIn(size_t p, size_t i0, size_t i1, size_t i2, double* bary)
+{
+    double x = coords_[2 * p], y = coords_[2 * p + 1];
+    double x1 = coords_[2 * i0], y1 = coords_[2 * i0 + 1];
+    double x2 = coords_[2 * i1], y2 = coords_[2 * i1 + 1];
+    double x3 = coords_[2 * i2], y3 = coords_[2 * i2 + 1];
+    double inv_det = 1/ ( (x1 - x3) * (y2 - y3) - (x2 - x3) * (y1 - y3) );
+    bary[0] = inv_det * ( (y2 - y3) * (x - x3) + (x3 - x2) * (y - y3) );
+    bary[1] = inv_det * ( (y3 - y1) * (x - x3) + (x1 - x3) * (y - y3) );
+    bary[2] = 1 - bary[0] - bary[1];
+    return bary[0] * val_[i0] + bary[1] * val_[i1] + bary[2] * val_[i2];
+}
+
+size_t Decimator::locateIn(size_t p, std::vector<size_t>& fill)
+{
+    size_t best(0);
+    double best_min = -std::numeric_limits<double>::max();
+    double bary[3];
+    for (size_t t = 0; t < fill.size(); t += 3){
+        interpIn(p, fill[t], fill[t + 1], fill[t + 2], bary);
+        double lowest = std::min(bary[0], std::min(bary[1], bary[2]));
+        if (lowest > best_min){
+            best_min = lowest;
+            best = t;
+        }
+    }
+    return best;
+}
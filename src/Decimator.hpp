@@ -0,0 +1,117 @@
+//  Decimator.hpp
+//  delta_xcode
+//
+//  Removes vertices from a point set while the linear interpolant stays close to the data
+//
+
+#ifndef decimator_h
+#define decimator_h
+
+#include "Mesh.hpp"
+
+/**
+ *\brief Greedy vertex removal to a target interpolation error
+ *\details The point set is triangulated once. Interior vertices are then removed cheapest first:
+ *         removing a vertex retriangulates the hole left by its star with Delaunay ears, which is
+ *         exactly the Delaunay triangulation of the remaining points. The cost of a removal is the
+ *         largest change it makes to the interpolant at any original point inside the star, the
+ *         removed vertex and the ones removed before it. Hull vertices are kept, so the domain
+ *         doesn't shrink.
+ */
+class Decimator
+{
+public:
+    /**
+     *\brief Triangulates the full point set. Nothing is removed yet.
+     *\param coords Coordinates {x1, y1, x2, y2, ...}, as for Mesh
+     *\param val    Function values on the points
+     */
+    Decimator(VecDoub& coords, VecDoub& val);
+
+    /**
+     *\brief Removes vertices as long as the error at every original point stays within tol
+     *\param tol Largest allowed |interpolated - val| at any of the original points
+     *\return Number of vertices removed by this call
+     *\note Can be called again with a larger tolerance to keep going.
+     */
+    size_t run(double tol);
+
+    /**
+     *\brief Number of vertices still in the triangulation
+     */
+    size_t size();
+
+    /**
+     *\brief Largest error at the original points introduced by the removals so far
+     */
+    double maxError();
+
+    /**
+     *\brief Indices (into the input) of the points that are kept
+     */
+    std::vector<size_t> kept();
+
+    /**
+     *\brief Coordinates and values of the kept points, ready to construct a smaller Mesh
+     *\note Duplicate points, which the triangulation leaves out, are not returned. The error
+     *      bound holds for this triangulation; a Mesh built from the kept points may pick the
+     *      other diagonal where four points are cocircular.
+     */
+    void remaining(VecDoub& coords, VecDoub& val);
+
+private:
+    /**
+     *\brief Collects the star of interior vertex v
+     *\param link  Vertices around v, in the orientation of the mesh triangles
+     *\param inner Half edges of the star triangles opposite to v, matching link
+     *\param triags Triangles of the star
+     */
+    void star(size_t v, std::vector<size_t>& link, std::vector<size_t>& inner,
+              std::vector<size_t>& triags);
+
+    /**
+     *\brief Retriangulates the polygon link with Delaunay ears
+     *\param fill Vertex triples of the new triangles; each triple starts at the ear tip's predecessor
+     *\param sides For every new triangle edge, the position in link of its polygon edge, or -1 for diagonals
+     *\return false if no valid ear was found (degenerate input)
+     */
+    bool fillHole(std::vector<size_t>& link, std::vector<size_t>& fill, std::vector<int>& sides);
+
+    /**
+     *\brief Error of removing v; infinite if it can't be removed
+     */
+    double cost(size_t v);
+
+    /**
+     *\brief Removes v and relinks the half edges around the hole
+     *\param link Receives the vertices around the hole
+     */
+    void remove(size_t v, std::vector<size_t>& link);
+
+    /**
+     *\brief Interpolated value at original point p within the triangle (i0, i1, i2)
+     *\param bary Receives the barycentric coordinates
+     */
+    double interpIn(size_t p, size_t i0, size_t i1, size_t i2, double* bary);
+
+    /**
+     *\brief Triangle in fill that contains original point p: the one with the largest smallest barycentric coordinate
+     */
+    size_t locateIn(size_t p, std::vector<size_t>& fill);
+
+    VecDoub coords_;
+    VecDoub val_;
+    std::vector<size_t> triangles_;
+    std::vector<size_t> halfedges_;
+    std::vector<size_t> inedges_;               // one incoming half edge per vertex
+    std::vector<char> removed_;                 // per vertex
+    std::vector<char> hull_;                    // per vertex; hull vertices are never removed
+    std::vector<char> dead_;                    // per triangle; slots freed by removals
+    std::vector<std::vector<size_t> > inside_;  // per triangle; removed points that lie in it
+    std::vector<size_t> stamp_;                 // per vertex; bumped when its star changes
+    double orientation_;                        // sign of the signed area of the mesh triangles
+    double max_error_;
+    size_t size_;
+};
+
+#endif /* decimator_h */
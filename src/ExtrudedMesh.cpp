@@ -0,0 +1,102 @@
+//  ExtrudedMesh.cpp
+//  delta_xcode
+//
+
+#include "ExtrudedMesh.hpp"
+#include <algorithm>
+
+ExtrudedMesh::ExtrudedMesh(VecDoub& coords, VecDoub& axis, VecDoub& val, double period)
+    :axis_(axis), val_(val), period_(period),
+     plane0_(val.begin(), val.begin() + std::min(val.size(), coords.size() /2)),
+     mesh_(coords, plane0_)
+{
+    VecDoub().swap(plane0_); // the mesh keeps its own copy
+    bool increasing = !axis_.empty();
+    for (size_t k = 0; increasing && k + 1 < axis_.size(); k++){
+        increasing = axis_[k] < axis_[k + 1];
+    }
+    if (increasing && period_ > 0) increasing = axis_.back() < axis_.front() + period_;
+    try {
+        if (!increasing) throw ExitException(10);
+        if (val_.size() != axis_.size() * mesh_.size()){
+            std::cerr << "Found " << val_.size() << " values for " << axis_.size() << " planes of ";
+            std::cerr << mesh_.size() << " points." << std::endl;
+            throw ExitException(1);
+        }
+    } catch (ExitException& e) {
+        e.what();
+    }
+}
+
+size_t ExtrudedMesh::size()
+{
+    return mesh_.size();
+}
+
+size_t ExtrudedMesh::numPlanes()
+{
+    return axis_.size();
+}
+
+Mesh& ExtrudedMesh::mesh()
+{
+    return mesh_;
+}
+
+size_t ExtrudedMesh::locate(MeshPoint p, size_t init)
+{
+    return mesh_.locate(p, init);
+}
+
+void ExtrudedMesh::bracket(double z, size_t& lower, size_t& upper, double& weight)
+{
+    size_t n = axis_.size();
+    if (period_ > 0){
+        // bring z into [axis_[0], axis_[0] + period)
+        z = axis_.front() + (z - axis_.front()) - period_ * std::floor((z - axis_.front()) / period_);
+        if (z >= axis_.back()){
+            // between the last plane and the first one of the next period
+            lower = n - 1;
+            upper = 0;
+            weight = (z - axis_.back()) / (axis_.front() + period_ - axis_.back());
+            return;
+        }
+    }
+    try {
+        if (!(z >= axis_.front() && z <= axis_.back())) throw ExitException(3);
+    } catch (ExitException& e) {
+        e.what();
+    }
+    if (n == 1){
+        lower = upper = 0;
+        weight = 0;
+        return;
+    }
+    upper = std::upper_bound(axis_.begin(), axis_.end(), z) - axis_.begin();
+    upper = std::min(std::max(upper, size_t(1)), n - 1);
+    lower = upper - 1;
+    weight = (z - axis_[lower]) / (axis_[upper] - axis_[lower]);
+}
+
+double ExtrudedMesh::interpInTriag(MeshPoint p, double z, size_t t)
+{
+    size_t lower, upper;
+    double weight;
+    bracket(z, lower, upper, weight);
+    VecDoub bary = mesh_.barycentric(p, t);
+    std::vector<size_t> points = mesh_.pointsOfTriag(t); // coordinate indices {2 v, 2 v + 1, ...}
+    size_t nv = mesh_.size();
+    double rtn(0);
+    for (size_t i = 0; i < 3; i++){
+        size_t v = points[2 * i] / 2;
+        double v_lower = val_[lower * nv + v];
+        double v_upper = val_[upper * nv + v];
+        rtn += bary[i] * ((1 - weight) * v_lower + weight * v_upper);
+    }
+    return rtn;
+}
+
+double ExtrudedMesh::interp(MeshPoint p, double z, size_t init)
+{
+    return interpInTriag(p, z, locate(p, init));
+}
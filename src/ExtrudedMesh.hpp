@@ -0,0 +1,81 @@
+//  ExtrudedMesh.hpp
+//  delta_xcode
+//
+//  One 2D triangulation repeated along a third axis
+//
+
+#ifndef extruded_mesh_h
+#define extruded_mesh_h
+
+#include "Mesh.hpp"
+
+/**
+ *\brief Field on a 2D point set repeated on the planes of a 1D axis, e.g. poloidal planes along
+ *       the toroidal angle
+ *\details The 2D points are triangulated once. A query (p, z) is located once in 2D, z is
+ *          bracketed by binary search on the axis, and the result blends the barycentric
+ *          interpolations on the two bracketing planes linearly in z. The field is linear on every
+ *          triangle of a plane and along the axis: a prism element.
+ *
+ *          Values are stored plane by plane: the value at vertex v on plane k is val[k * nv + v],
+ *          with nv the number of 2D points.
+ */
+class ExtrudedMesh
+{
+public:
+    /**
+     *\brief Triangulates the 2D points
+     *\param coords 2D coordinates {x1, y1, x2, y2, ...}, as for Mesh
+     *\param axis   Positions of the planes, strictly increasing
+     *\param val    Values, axis.size() * nv of them, plane by plane
+     *\param period If positive, the axis is periodic with this period (e.g. 2 pi), and the last
+     *              plane is followed by the first one shifted by a period
+     */
+    ExtrudedMesh(VecDoub& coords, VecDoub& axis, VecDoub& val, double period = 0);
+
+    /**
+     *\brief Number of 2D points
+     */
+    size_t size();
+
+    /**
+     *\brief Number of planes
+     */
+    size_t numPlanes();
+
+    /**
+     *\brief The shared 2D triangulation; its own values are those of plane 0
+     */
+    Mesh& mesh();
+
+    /**
+     *\brief Triangle of the 2D mesh containing p, see Mesh::locate
+     */
+    size_t locate(MeshPoint p, size_t init);
+
+    /**
+     *\brief Interpolation at (p, z)
+     *\param init Index of the triangle to start searching for p in
+     *\note With a non-periodic axis, z has to lie within the axis.
+     */
+    double interp(MeshPoint p, double z, size_t init);
+
+    /**
+     *\brief Interpolation at (p, z) with p known to be in triangle t; no 2D search is done
+     */
+    double interpInTriag(MeshPoint p, double z, size_t t);
+
+private:
+    /**
+     *\brief Bracketing planes of z and the weight of the upper one
+     */
+    void bracket(double z, size_t& lower, size_t& upper, double& weight);
+
+    VecDoub axis_;
+    VecDoub val_;
+    double period_;
+    VecDoub plane0_;  // only passed to the Mesh constructor
+    Mesh mesh_;
+};
+
+#endif /* extruded_mesh_h */
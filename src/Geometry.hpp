@@ -0,0 +1,93 @@
+//  Geometry.hpp
+//  delta_xcode
+//
+//  Small polygon helpers shared by the mesh integrals and transfers
+//
+
+#ifndef geometry_h
+#define geometry_h
+
+#include "Mesh.hpp"
+
+typedef std::vector<MeshPoint> Polygon;
+
+/**
+ *\brief Signed area of a polygon; positive if the vertices run counterclockwise
+ */
+inline double polygonArea(const Polygon& poly)
+{
+    double sum(0);
+    for (size_t i = 0; i < poly.size(); i++){
+        const MeshPoint& a = poly[i];
+        const MeshPoint& b = poly[(i + 1) % poly.size()];
+        sum += a.x_ * b.y_ - b.x_ * a.y_;
+    }
+    return sum / 2;
+}
+
+/**
+ *\brief Barycentric coordinates of p with respect to the triangle (a, b, c)
+ *\param lambda Receives {lambda_a, lambda_b, lambda_c}
+ */
+inline void barycentricOf(const MeshPoint& p, const MeshPoint& a, const MeshPoint& b,
+                          const MeshPoint& c, double* lambda)
+{
+    double inv_det = 1/ ( (a.x_ - c.x_) * (b.y_ - c.y_) - (b.x_ - c.x_) * (a.y_ - c.y_) );
+    lambda[0] = inv_det * ( (b.y_ - c.y_) * (p.x_ - c.x_) + (c.x_ - b.x_) * (p.y_ - c.y_) );
+    lambda[1] = inv_det * ( (c.y_ - a.y_) * (p.x_ - c.x_) + (a.x_ - c.x_) * (p.y_ - c.y_) );
+    lambda[2] = 1 - lambda[0] - lambda[1];
+}
+
+/**
+ *\brief Position of p along a Morton (Z-order) curve over the box [x_lo, x_hi] x [y_lo, y_hi]
+ *\details 16 bits per axis. Points sorted by this key are close to the ones before them, so
+ *          searches started from the previous result stay short.
+ */
+inline uint32_t mortonKey(const MeshPoint& p, double x_lo, double x_hi, double y_lo, double y_hi)
+{
+    double sx = (x_hi > x_lo) ? 65535 / (x_hi - x_lo) : 0;
+    double sy = (y_hi > y_lo) ? 65535 / (y_hi - y_lo) : 0;
+    uint32_t ix = uint32_t((p.x_ - x_lo) * sx);
+    uint32_t iy = uint32_t((p.y_ - y_lo) * sy);
+    uint32_t key = 0;
+    for (int b = 0; b < 16; b++){
+        key |= ((ix >> b) & 1u) << (2 * b);
+        key |= ((iy >> b) & 1u) << (2 * b + 1);
+    }
+    return key;
+}
+
+/**
+ *\brief Clips a polygon against a convex polygon (Sutherland-Hodgman)
+ *\param subject Polygon to clip, any orientation. Need not be convex.
+ *\param clip    Convex clipping polygon, any orientation
+ *\param out     Receives subject cut down to the inside of clip. Non-convex subjects may come out
+ *               with zero-width bridges, which don't change areas or integrals.
+ */
+inline void clipPolygon(const Polygon& subject, const Polygon& clip, Polygon& out)
+{
+    out = subject;
+    double orientation = (polygonArea(clip) < 0) ? -1 : 1;
+    Polygon in;
+    for (size_t i = 0; i < clip.size() && !out.empty(); i++){
+        const MeshPoint& a = clip[i];
+        const MeshPoint& b = clip[(i + 1) % clip.size()];
+        in.swap(out);
+        out.clear();
+        for (size_t j = 0; j < in.size(); j++){
+            const MeshPoint& p = in[j];
+            const MeshPoint& q = in[(j + 1) % in.size()];
+            // distance to the clip edge, positive on the inside
+            double dp = ((b.x_ - a.x_) * (p.y_ - a.y_) - (b.y_ - a.y_) * (p.x_ - a.x_)) * orientation;
+            double dq = ((b.x_ - a.x_) * (q.y_ - a.y_) - (b.y_ - a.y_) * (q.x_ - a.x_)) * orientation;
+            if (dp >= 0) out.push_back(p);
+            if ((dp >= 0) != (dq >= 0)){
+                double s = dp / (dp - dq);
+                out.push_back(MeshPoint(p.x_ + s * (q.x_ - p.x_), p.y_ + s * (q.y_ - p.y_)));
+            }
+        }
+    }
+    if (out.size() < 3) out.clear();
+}
+
+#endif /* geometry_h */
@@ -0,0 +1,176 @@
+//  InterpOperator.cpp
+//  delta_xcode
+//
+
+#include "InterpOperator.hpp"
+#include "Geometry.hpp"
+#include <algorithm>
+
+InterpOperator::InterpOperator()
+    :ncols_(0), row_ptr_(1, 0)
+{
+    // nothing else to do
+}
+
+InterpOperator::InterpOperator(Mesh& mesh, std::vector<MeshPoint>& points)
+    :ncols_(mesh.size()), row_ptr_(points.size() + 1), cols_(3 * points.size()), weights_(3 * points.size())
+{
+    TraceSpan span("InterpOperator::build");
+    if (points.empty()){
+        row_ptr_[0] = 0;
+        return;
+    }
+    double x_lo = points[0].x_, x_hi = x_lo, y_lo = points[0].y_, y_hi = y_lo;
+    for (size_t i = 1; i < points.size(); i++){
+        x_lo = std::min(x_lo, points[i].x_);
+        x_hi = std::max(x_hi, points[i].x_);
+        y_lo = std::min(y_lo, points[i].y_);
+        y_hi = std::max(y_hi, points[i].y_);
+    }
+    std::vector<std::pair<uint32_t, size_t> > order(points.size());
+    for (size_t i = 0; i < points.size(); i++){
+        order[i] = std::make_pair(mortonKey(points[i], x_lo, x_hi, y_lo, y_hi), i);
+    }
+    std::sort(order.begin(), order.end());
+
+    // three entries per row; rows are filled in search order but stored in point order
+    for (size_t i = 0; i <= points.size(); i++){
+        row_ptr_[i] = 3 * i;
+    }
+    size_t t = 0;
+    for (size_t n = 0; n < order.size(); n++){
+        size_t i = order[n].second;
+        t = mesh.locate(points[i], t);
+        VecDoub bary = mesh.barycentric(points[i], t);
+        std::vector<size_t> corners = mesh.pointsOfTriag(t); // coordinate indices {2 v, 2 v + 1, ...}
+        for (size_t j = 0; j < 3; j++){
+            cols_[3 * i + j] = corners[2 * j] / 2;
+            weights_[3 * i + j] = bary[j];
+        }
+    }
+}
+
+size_t InterpOperator::rows()
+{
+    return row_ptr_.size() - 1;
+}
+
+size_t InterpOperator::columns()
+{
+    return ncols_;
+}
+
+size_t InterpOperator::nonzeros()
+{
+    return weights_.size();
+}
+
+VecDoub InterpOperator::apply(VecDoub& val, unsigned int nthreads)
+{
+    if (val.size() != ncols_){
+        try {
+            throw ExitException(1);
+        } catch (ExitException& e) {
+            std::cerr << "Found " << val.size() << " values for an operator on ";
+            std::cerr << ncols_ << " vertices." << std::endl;
+            std::cout << e.what() << std::endl;
+        }
+    }
+    VecDoub out(rows());
+    if (!out.empty()) apply(&val[0], &out[0], nthreads);
+    return out;
+}
+
+void InterpOperator::apply(const double* val, double* out, unsigned int nthreads)
+{
+    size_t n = rows();
+    if (n == 0) return;
+    if (nthreads == 0) nthreads = std::max(1u, std::thread::hardware_concurrency());
+    // not worth a thread for less than a few thousand rows
+    nthreads = unsigned(std::max(size_t(1), std::min(size_t(nthreads), n / 4096)));
+
+    // every row is a separate dot product, so the split doesn't change the results
+    size_t chunk = (n + nthreads - 1) / nthreads;
+    auto rowRange = [&](size_t i_begin, size_t i_end){
+        for (size_t i = i_begin; i < i_end; i++){
+            double sum(0);
+            for (uint64_t k = row_ptr_[i]; k < row_ptr_[i + 1]; k++){
+                sum += weights_[k] * val[cols_[k]];
+            }
+            out[i] = sum;
+        }
+    };
+    if (nthreads == 1){
+        rowRange(0, n);
+        return;
+    }
+    std::vector<std::thread> workers;
+    for (unsigned int k = 0; k < nthreads; k++){
+        workers.push_back(std::thread(rowRange, k * chunk, std::min(n, (k + 1) * chunk)));
+    }
+    for (size_t k = 0; k < workers.size(); k++){
+        workers[k].join();
+    }
+}
+
+bool InterpOperator::save(const char* fname)
+{
+    FILE* f = fopen(fname, "wb");
+    if (f == NULL) return false;
+    uint32_t version = 1;
+    uint64_t header[3] = {rows(), ncols_, weights_.size()};
+    bool ok = fwrite("DIOP", 1, 4, f) == 4;
+    ok = ok && fwrite(&version, sizeof(version), 1, f) == 1;
+    ok = ok && fwrite(header, sizeof(uint64_t), 3, f) == 3;
+    ok = ok && fwrite(&row_ptr_[0], sizeof(uint64_t), row_ptr_.size(), f) == row_ptr_.size();
+    if (!weights_.empty()){
+        ok = ok && fwrite(&cols_[0], sizeof(uint64_t), cols_.size(), f) == cols_.size();
+        ok = ok && fwrite(&weights_[0], sizeof(double), weights_.size(), f) == weights_.size();
+    }
+    return (fclose(f) == 0) && ok;
+}
+
+bool InterpOperator::load(const char* fname)
+{
+    *this = InterpOperator();
+    FILE* f = fopen(fname, "rb");
+    if (f == NULL) return false;
+    char magic[4];
+    uint32_t version(0);
+    uint64_t header[3];
+    bool ok = fread(magic, 1, 4, f) == 4 && std::equal(magic, magic + 4, "DIOP");
+    ok = ok && fread(&version, sizeof(version), 1, f) == 1;
+    // everything is in the writer's byte order; a version that reads 0x01000000 means it isn't ours
+    ok = ok && version == 1;
+    ok = ok && fread(header, sizeof(uint64_t), 3, f) == 3;
+    if (ok){
+        // the sizes have to match what is left of the file before anything is allocated
+        long start = ftell(f);
+        ok = fseek(f, 0, SEEK_END) == 0;
+        long bytes = ftell(f) - start;
+        ok = ok && fseek(f, start, SEEK_SET) == 0 && header[0] < uint64_t(bytes) && header[2] < uint64_t(bytes)
+                && uint64_t(bytes) == 8 * (header[0] + 1) + 16 * header[2];
+    }
+    if (ok){
+        row_ptr_.resize(header[0] + 1);
+        ncols_ = header[1];
+        cols_.resize(header[2]);
+        weights_.resize(header[2]);
+        ok = fread(&row_ptr_[0], sizeof(uint64_t), row_ptr_.size(), f) == row_ptr_.size();
+        if (!weights_.empty()){
+            ok = ok && fread(&cols_[0], sizeof(uint64_t), cols_.size(), f) == cols_.size();
+            ok = ok && fread(&weights_[0], sizeof(double), weights_.size(), f) == weights_.size();
+        }
+    }
+    // reject anything that would index out of bounds in apply
+    ok = ok && row_ptr_.front() == 0 && row_ptr_.back() == weights_.size();
+    for (size_t i = 0; ok && i + 1 < row_ptr_.size(); i++){
+        ok = row_ptr_[i] <= row_ptr_[i + 1];
+    }
+    for (size_t k = 0; ok && k < cols_.size(); k++){
+        ok = cols_[k] < ncols_;
+    }
+    fclose(f);
+    if (!ok) *this = InterpOperator();
+    return ok;
+}
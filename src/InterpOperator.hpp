@@ -0,0 +1,83 @@
+//  InterpOperator.hpp
+//  delta_xcode
+//
+//  Interpolation at fixed points as a sparse matrix, built once and applied to many fields
+//
+
+#ifndef interp_operator_h
+#define interp_operator_h
+
+#include "Mesh.hpp"
+
+/**
+ *\brief Linear interpolation from the vertices of a Mesh to a fixed set of points, in CSR form
+ *\details Row i holds the vertices of the triangle containing point i and their barycentric
+ *          weights, so applying the operator to a field on the vertices gives the same values as
+ *          Mesh::interp at every point, without searching again. The points are located once, in
+ *          Morton order, each search starting from the previous result.
+ *
+ *          The operator only depends on the triangulation and the points, not on the values, and
+ *          can be saved and loaded to reuse it across runs on the same mesh.
+ */
+class InterpOperator
+{
+public:
+    /**
+     *\brief Empty operator; fill it with load
+     */
+    InterpOperator();
+
+    /**
+     *\brief Locates the points on the mesh and stores the weights
+     *\param points Query points, all inside the domain
+     */
+    InterpOperator(Mesh& mesh, std::vector<MeshPoint>& points);
+
+    /**
+     *\brief Number of rows (query points) and columns (mesh vertices)
+     */
+    size_t rows();
+    size_t columns();
+
+    /**
+     *\brief Number of stored weights
+     */
+    size_t nonzeros();
+
+    /**
+     *\brief Interpolated values at the points for the field val on the vertices
+     *\param val      One value per vertex, columns() of them
+     *\param nthreads Number of threads; 0 uses all hardware threads
+     */
+    VecDoub apply(VecDoub& val, unsigned int nthreads = 0);
+
+    /**
+     *\brief Same as above on raw arrays: reads columns() values, writes rows() values
+     */
+    void apply(const double* val, double* out, unsigned int nthreads = 0);
+
+    /**
+     *\brief Writes the operator to a binary file
+     *\details Layout, in host byte order: "DIOP", uint32 version (1), uint64 rows, columns,
+     *          nonzeros; then rows + 1 uint64 row offsets, nonzeros uint64 column indices and
+     *          nonzeros double weights. The version doubles as a byte-order mark, so load rejects
+     *          a file written on a host of the other byte order.
+     *\return false if the file can't be written
+     */
+    bool save(const char* fname);
+
+    /**
+     *\brief Replaces the operator with one read from a file written by save
+     *\return false if the file can't be read, isn't an operator or has the other byte order; the
+     *         operator is then empty
+     */
+    bool load(const char* fname);
+
+private:
+    size_t ncols_;
+    std::vector<uint64_t> row_ptr_;  // row i is [row_ptr_[i], row_ptr_[i + 1])
+    std::vector<uint64_t> cols_;
+    VecDoub weights_;
+};
+
+#endif /* interp_operator_h */
@@ -0,0 +1,142 @@
+//  MappedMesh.cpp
+//  delta_xcode
+//
+
+#include "MappedMesh.hpp"
+#include "Geometry.hpp"
+#include <algorithm>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+MappedMesh::MappedMesh()
+    :map_(NULL), bytes_(0), npoints_(0), ntriag_(0), coords_(NULL), val_(NULL),
+     triangles_(NULL), halfedges_(NULL)
+{
+    // nothing else to do
+}
+
+MappedMesh::~MappedMesh()
+{
+    close();
+}
+
+void MappedMesh::close()
+{
+    if (map_ != NULL) munmap(map_, bytes_);
+    map_ = NULL;
+    bytes_ = npoints_ = ntriag_ = 0;
+    coords_ = val_ = NULL;
+    triangles_ = halfedges_ = NULL;
+}
+
+bool MappedMesh::open(const char* fname)
+{
+    close();
+    int fd = ::open(fname, O_RDONLY);
+    if (fd < 0) return false;
+    struct stat st;
+    bool ok = fstat(fd, &st) == 0 && st.st_size >= 24;
+    if (ok){
+        bytes_ = size_t(st.st_size);
+        map_ = mmap(NULL, bytes_, PROT_READ, MAP_SHARED, fd, 0);
+        if (map_ == MAP_FAILED) map_ = NULL;
+        ok = map_ != NULL;
+    }
+    ::close(fd);
+    if (ok){
+        const char* base = static_cast<const char*>(map_);
+        uint32_t version;
+        uint64_t header[2];
+        std::copy(base + 4, base + 8, reinterpret_cast<char*>(&version));
+        std::copy(base + 8, base + 24, reinterpret_cast<char*>(header));
+        // sizes are checked against the file before any of them is used as an offset; the file is
+        // in the writer's byte order, and a version that reads 0x01000000 means it isn't ours
+        ok = std::equal(base, base + 4, "DMSH") && version == 1
+             && header[0] < bytes_ && header[1] < bytes_
+             && bytes_ == 24 + 24 * header[0] + 48 * header[1];
+        if (ok){
+            npoints_ = header[0];
+            ntriag_ = header[1];
+            coords_ = reinterpret_cast<const double*>(base + 24);
+            val_ = coords_ + 2 * npoints_;
+            triangles_ = reinterpret_cast<const uint64_t*>(val_ + npoints_);
+            halfedges_ = triangles_ + 3 * ntriag_;
+        }
+    }
+    for (size_t e = 0; ok && e < 3 * ntriag_; e++){
+        ok = triangles_[e] < npoints_
+             && (halfedges_[e] == uint64_t(delaunator::INVALID_INDEX) || halfedges_[e] < 3 * ntriag_);
+    }
+    if (!ok) close();
+    return ok;
+}
+
+size_t MappedMesh::size()
+{
+    return npoints_;
+}
+
+size_t MappedMesh::numTriag()
+{
+    return ntriag_;
+}
+
+const double* MappedMesh::values()
+{
+    return val_;
+}
+
+void MappedMesh::verticesOfTriag(size_t t, size_t* v)
+{
+    t -= t % 3;
+    for (size_t k = 0; k < 3; k++){
+        v[k] = triangles_[t + k];
+    }
+}
+
+size_t MappedMesh::tryLocate(MeshPoint p, size_t init)
+{
+    size_t t = init - (init % 3);
+    if (t >= 3 * ntriag_) return delaunator::INVALID_INDEX;
+    // visibility walk: leave through any edge that has p strictly on its outer side
+    for (size_t steps = 0; steps <= ntriag_; steps++){
+        const double* v[3];
+        for (size_t k = 0; k < 3; k++){
+            v[k] = coords_ + 2 * triangles_[t + k];
+        }
+        double orientation = (v[1][0] - v[0][0]) * (v[2][1] - v[0][1]) - (v[1][1] - v[0][1]) * (v[2][0] - v[0][0]);
+        size_t exit = delaunator::INVALID_INDEX;
+        for (size_t k = 0; k < 3 && exit == delaunator::INVALID_INDEX; k++){
+            const double* a = v[k];
+            const double* b = v[(k + 1) % 3];
+            double side = (b[0] - a[0]) * (p.y_ - a[1]) - (b[1] - a[1]) * (p.x_ - a[0]);
+            if (side * orientation < 0) exit = t + k;
+        }
+        if (exit == delaunator::INVALID_INDEX) return t;
+        uint64_t h = halfedges_[exit];
+        if (h == uint64_t(delaunator::INVALID_INDEX)) return delaunator::INVALID_INDEX;
+        t = size_t(h - h % 3);
+    }
+    return delaunator::INVALID_INDEX;
+}
+
+double MappedMesh::interpInTriag(MeshPoint p, size_t t)
+{
+    size_t v[3];
+    verticesOfTriag(t, v);
+    MeshPoint a(coords_[2 * v[0]], coords_[2 * v[0] + 1]);
+    MeshPoint b(coords_[2 * v[1]], coords_[2 * v[1] + 1]);
+    MeshPoint c(coords_[2 * v[2]], coords_[2 * v[2] + 1]);
+    double lambda[3];
+    barycentricOf(p, a, b, c, lambda);
+    return lambda[0] * val_[v[0]] + lambda[1] * val_[v[1]] + lambda[2] * val_[v[2]];
+}
+
+double MappedMesh::interp(MeshPoint p, size_t init)
+{
+    size_t t = tryLocate(p, init);
+    if (t == delaunator::INVALID_INDEX) return std::nan("");
+    return interpInTriag(p, t);
+}
@@ -0,0 +1,88 @@
+//  MappedMesh.hpp
+//  delta_xcode
+//
+//  Read-only queries on a mesh file written by StreamingTriangulator, memory-mapped from disk
+//
+
+#ifndef mapped_mesh_h
+#define mapped_mesh_h
+
+#include "Mesh.hpp"
+#include <stdint.h>
+
+/**
+ *\brief A triangulation on disk, mapped into memory instead of read
+ *\details The file holds, after a header, the points, the values, the triangles and the half edges
+ *          in the layout of delaunator::Delaunator, so a query touches only the pages it walks
+ *          through and the operating system keeps the hot ones cached. Triangles are identified by
+ *          their first half edge, as in Mesh.
+ *
+ *          File layout, in host byte order since it is mapped as is: "DMSH", uint32 version (1),
+ *          uint64 points n, uint64 triangles m; then 2 n double coordinates, n double values, 3 m
+ *          uint64 vertex indices and 3 m uint64 opposite half edges (delaunator::INVALID_INDEX on
+ *          the hull). The version doubles as a byte-order mark, so a file written on a host of the
+ *          other byte order is rejected by open.
+ */
+class MappedMesh
+{
+public:
+    MappedMesh();
+
+    ~MappedMesh();
+
+    /**
+     *\brief Maps a mesh file, replacing whatever was mapped
+     *\return false if the file can't be mapped, isn't a mesh file or has the other byte order; the
+     *         mesh is then empty
+     */
+    bool open(const char* fname);
+
+    /**
+     *\brief Number of points and of triangles
+     */
+    size_t size();
+    size_t numTriag();
+
+    /**
+     *\brief Value on each point, size() of them
+     */
+    const double* values();
+
+    /**
+     *\brief Vertex indices of triangle t
+     */
+    void verticesOfTriag(size_t t, size_t* v);
+
+    /**
+     *\brief Triangle containing p, walking from triangle init
+     *\return delaunator::INVALID_INDEX if p is outside the domain
+     */
+    size_t tryLocate(MeshPoint p, size_t init);
+
+    /**
+     *\brief Linear interpolation in a known triangle
+     */
+    double interpInTriag(MeshPoint p, size_t t);
+
+    /**
+     *\brief Linear interpolation at p, searching from triangle init; NaN outside the domain
+     */
+    double interp(MeshPoint p, size_t init);
+
+private:
+    MappedMesh(const MappedMesh&);
+    MappedMesh& operator=(const MappedMesh&);
+
+    void close();
+
+    void* map_;
+    size_t bytes_;
+    size_t npoints_;
+    size_t ntriag_;
+    const double* coords_;
+    const double* val_;
+    const uint64_t* triangles_;
+    const uint64_t* halfedges_;
+};
+
+#endif /* mapped_mesh_h */
@@ -6,6 +6,7 @@
 //
 
 #include "Mesh.hpp"
+#include "Geometry.hpp"
 
 LineSeg::LineSeg(MeshPoint& pa, MeshPoint& pb)
         :pa_(pa), pb_(pb) // using copy constructor
@@ -19,7 +20,7 @@ bool LineSeg::parallel(LineSeg &line_b)
     MeshPoint diff_a = pa_ - pb_;
     MeshPoint diff_b = line_b.pa_ - line_b.pb_;
     double result = diff_a.cross(diff_b);
-    return (abs(result) < 1e-15);
+    return (std::fabs(result) < 1e-15);
 }
 
 double LineSeg::signedArea(MeshPoint& pc)
@@ -65,9 +66,9 @@ bool LineSeg::isCross(LineSeg &line_b)
 
 
 Mesh::Mesh(VecDoub& coords, VecDoub& val)
-    :d_(coords), coords_(coords), val_(val)
+    :coords_(coords), val_(val), d_(coords_), compact_(false), generation_(0)
 {
-    // Delaunator is constructed in colon initialization
+    // Delaunator is constructed in colon initialization, on the mesh's own copy of the coordinates
     if (val_.size() != coords_.size() /2){
         try {
             throw ExitException(1);
@@ -79,20 +80,254 @@ Mesh::Mesh(VecDoub& coords, VecDoub& val)
     }
 }
 
+Mesh::Mesh(const Mesh& other)
+    :coords_(other.coords_), val_(other.val_), d_(other.d_, coords_), compact_(other.compact_),
+     tri32_(other.tri32_), half32_(other.half32_), inedges_(other.inedges_), dual_(other.dual_),
+     generation_(other.generation_)
+{
+    // a plain member-wise copy would leave d_ reading other's coordinates
+}
+
+Mesh::Mesh(const Mesh& other, bool queries_only)
+    :coords_(other.coords_), val_(other.val_), d_(other.d_, coords_, !queries_only), compact_(other.compact_),
+     tri32_(other.tri32_), half32_(other.half32_), inedges_(other.inedges_), generation_(other.generation_)
+{
+    if (!queries_only) dual_ = other.dual_;
+}
+
+void Mesh::rebuild(VecDoub& coords, VecDoub& val)
+{
+    TraceSpan span("Mesh::rebuild");
+    span.arg("points", double(coords.size() / 2));
+    if (val.size() != coords.size() /2){
+        try {
+            throw ExitException(1);
+        } catch (ExitException& e) {
+            std::cerr << "Found " << val.size() << " values for ";
+            std::cerr << coords.size() /2 << " pairs of coordinates." << std::endl;
+            std::cout << e.what() << std::endl;
+        }
+    }
+    // assign keeps the capacity; d_ refers to coords_, so it sees the new points
+    coords_.assign(coords.begin(), coords.end());
+    val_.assign(val.begin(), val.end());
+    if (compact_){
+        tri32_.clear();
+        half32_.clear();
+        compact_ = false;
+    }
+    d_.update();
+    if (!inedges_.empty()) buildVertexIndex();
+    dual_ = VoronoiDual();
+    generation_++;
+}
+
+bool Mesh::moveVertices(std::vector<size_t>& ids, VecDoub& xy)
+{
+    TraceSpan span("Mesh::moveVertices");
+    span.arg("moved", double(ids.size()));
+    try {
+        bool ok = xy.size() == 2 * ids.size();
+        for (size_t k = 0; ok && k < ids.size(); k++){
+            ok = ids[k] < size();
+        }
+        if (!ok){
+            throw ExitException(12);
+        }
+    } catch (ExitException& e) {
+        e.what();
+    }
+    // the flips work on the triangulation's own buffers
+    bool was_compact = compact_;
+    if (compact_){
+        d_.triangles.assign(tri32_.begin(), tri32_.end());
+        d_.halfedges.resize(half32_.size());
+        for (size_t e = 0; e < half32_.size(); e++){
+            d_.halfedges[e] = (half32_[e] == INVALID32) ? delaunator::INVALID_INDEX : half32_[e];
+        }
+        std::vector<uint32_t>().swap(tri32_);
+        std::vector<uint32_t>().swap(half32_);
+        compact_ = false;
+    }
+    if (inedges_.size() != size()) buildVertexIndex();
+
+    // one vertex at a time, so every star is checked against settled neighbors. When most of
+    // the points move, triangulating again is cheaper
+    std::vector<size_t> flipped;
+    bool local = ids.size() <= size() / 4;
+    if (local){
+        // a duplicate point or a hull vertex bending the hull inward means triangulating again;
+        // find them before any flips are spent on the vertices ahead of them. Flips never change
+        // the hull, so setting the hull vertices in turn sees it as the moves themselves will
+        VecDoub from(2 * ids.size());
+        for (size_t k = 0; k < ids.size(); k++){
+            size_t i = ids[k];
+            from[2 * k] = coords_[2 * i];
+            from[2 * k + 1] = coords_[2 * i + 1];
+            if (!local) continue;
+            if (inedges_[i] == delaunator::INVALID_INDEX){
+                local = false; // moved, it may need a place of its own
+            } else if (half(inedges_[i]) == delaunator::INVALID_INDEX){
+                coords_[2 * i] = xy[2 * k];
+                coords_[2 * i + 1] = xy[2 * k + 1];
+                local = hullConvex(i);
+            }
+        }
+        for (size_t k = ids.size(); k-- > 0;){ // backwards, in case a vertex is listed twice
+            coords_[2 * ids[k]] = from[2 * k];
+            coords_[2 * ids[k] + 1] = from[2 * k + 1];
+        }
+    }
+    for (size_t k = 0; local && k < ids.size(); k++){
+        local = moveVertex(ids[k], MeshPoint(xy[2 * k], xy[2 * k + 1]), flipped);
+    }
+    if (!local){
+        for (size_t k = 0; k < ids.size(); k++){
+            coords_[2 * ids[k]] = xy[2 * k];
+            coords_[2 * ids[k] + 1] = xy[2 * k + 1];
+        }
+        d_.update();
+        buildVertexIndex();
+    }
+    if (was_compact) compact();
+    dual_ = VoronoiDual();
+    generation_++;
+    span.arg("flips", double(flipped.size() / 2));
+    span.arg("local", local ? 1 : 0);
+    return local;
+}
+
+bool Mesh::moveVertex(size_t i, MeshPoint p, std::vector<size_t>& flipped)
+{
+    MeshPoint from = vertex(i);
+
+    // A vertex can only fold a triangle by crossing the edge opposite to it, and before that it
+    // enters the circumcircle of the triangle on the other side, which flips the edge away. So
+    // where the whole move folds a triangle, shorter steps with flips in between get there.
+    std::vector<size_t> edges;
+    double done(0), step(1);
+    while (done < 1){
+        double f = std::min(1.0, done + step);
+        coords_[2 * i] = from.x_ + f * (p.x_ - from.x_);
+        coords_[2 * i + 1] = from.y_ + f * (p.y_ - from.y_);
+        edges.clear();
+        if (!starValid(i, edges)){
+            step /= 2;
+            if (step < 1e-6) return false; // crossing the hull, or stuck
+            continue;
+        }
+        size_t first = flipped.size();
+        if (!d_.relegalize(edges, flipped)) return false;
+        // flips in a valid triangulation never fold a triangle; round-off near cocircular points might
+        for (size_t j = first; j < flipped.size(); j++){
+            size_t t = flipped[j] - flipped[j] % 3;
+            if (!(signedDoubleArea(tri(t), tri(t + 1), tri(t + 2)) > 0)) return false;
+        }
+        refreshVertexIndex(flipped, first);
+        done = f;
+        step *= 2;
+    }
+    coords_[2 * i] = p.x_; // exactly, whatever the steps added up to
+    coords_[2 * i + 1] = p.y_;
+    return true;
+}
+
+void Mesh::refreshVertexIndex(std::vector<size_t>& flipped, size_t first)
+{
+    if (first == flipped.size()) return;
+    // the index can only be stale where it points into a flipped triangle; hull edges stay hull
+    // edges, so a hull vertex finds its incoming one among them again
+    std::vector<size_t> changed;
+    for (size_t j = first; j < flipped.size(); j++){
+        changed.push_back(flipped[j] / 3);
+    }
+    std::sort(changed.begin(), changed.end());
+    changed.erase(std::unique(changed.begin(), changed.end()), changed.end());
+    for (size_t k = 0; k < changed.size(); k++){
+        for (size_t e = 3 * changed[k]; e < 3 * changed[k] + 3; e++){
+            size_t end = tri((e % 3 == 2) ? e - 2 : e + 1);
+            if (std::binary_search(changed.begin(), changed.end(), inedges_[end] / 3)){
+                inedges_[end] = delaunator::INVALID_INDEX;
+            }
+        }
+    }
+    for (size_t k = 0; k < changed.size(); k++){
+        for (size_t e = 3 * changed[k]; e < 3 * changed[k] + 3; e++){
+            size_t end = tri((e % 3 == 2) ? e - 2 : e + 1);
+            if (half(e) == delaunator::INVALID_INDEX || inedges_[end] == delaunator::INVALID_INDEX){
+                inedges_[end] = e;
+            }
+        }
+    }
+}
+
+bool Mesh::starValid(size_t i, std::vector<size_t>& edges)
+{
+    size_t e0 = inedges_[i];
+    size_t e = e0;
+    do {
+        size_t t = e - e % 3;
+        if (!(signedDoubleArea(tri(t), tri(t + 1), tri(t + 2)) > 0)) return false;
+        edges.push_back(t);
+        edges.push_back(t + 1);
+        edges.push_back(t + 2);
+        e = (e % 3 == 2) ? e - 2 : e + 1; // outgoing edge in the same triangle
+        e = half(e);
+    } while (e != delaunator::INVALID_INDEX && e != e0);
+    return true;
+}
+
+bool Mesh::hullConvex(size_t i)
+{
+    size_t in = inedges_[i];
+    if (half(in) != delaunator::INVALID_INDEX) return true; // not on the hull
+    auto next = [](size_t e){ return (e % 3 == 2) ? e - 2 : e + 1; };
+    // hull edge leaving the vertex that hull edge in leads to
+    auto hullOut = [&](size_t in){
+        size_t out = next(in);
+        while (half(out) != delaunator::INVALID_INDEX){
+            out = next(half(out));
+        }
+        return out;
+    };
+    auto convex = [&](size_t in, size_t out){
+        return signedDoubleArea(tri(in), tri(out), tri(next(out))) >= 0;
+    };
+    // the hull has to stay convex at i and at both hull neighbors, or flips can't give the
+    // Delaunay mesh: the triangles would no longer cover the convex hull
+    size_t out = hullOut(in);
+    return convex(in, out) && convex(inedges_[tri(in)], in) && convex(out, hullOut(out));
+}
+
 size_t Mesh::size()
 {
     return val_.size();
 }
 
+MeshPoint Mesh::vertex(size_t i)
+{
+    return MeshPoint(coords_[2 * i], coords_[2 * i + 1]);
+}
+
+size_t Mesh::generation()
+{
+    return generation_;
+}
+
+VecDoub& Mesh::values()
+{
+    return val_;
+}
+
 size_t Mesh::numTriag()
 {
-    return d_.triangles.size()/3;
+    return numEdges()/3;
 }
 
 std::vector<size_t> Mesh::edgesOfTriag(size_t t)
 {
     try {
-        if (t > d_.triangles.size()){
+        if (t > numEdges()){
             
             std::cout << t << " huh>>>" << std::endl;
             throw ExitException(4);
@@ -112,7 +347,7 @@ std::vector<size_t> Mesh::pointsOfTriag(size_t t)
     std::vector<size_t> edges = edgesOfTriag(t);
     for (int i = 0; i < 3; i++){
 //        size_t coord_id = d_.triangles[t + i];
-        size_t coord_id = d_.triangles.at(edges[i]); // safe retrieval
+        size_t coord_id = tri(edges[i]);
         out[2 * i]     = 2 * coord_id;     // x coordinate
         out[2 * i + 1] = 2 * coord_id + 1; // y coordinate
     }
@@ -122,7 +357,7 @@ std::vector<size_t> Mesh::pointsOfTriag(size_t t)
 size_t Mesh::triagOfEdge(size_t e)
 {
     try {
-        if (e >= d_.triangles.size()){
+        if (e >= numEdges()){
             throw ExitException(5);
         }
     } catch (ExitException& e) {
@@ -147,19 +382,19 @@ std::vector<MeshPoint> Mesh::coordsOfTriag(size_t t)
 
 LineSeg Mesh::edgeToLineSeg(size_t e)
 {
-    size_t start = d_.triangles[e];
+    size_t start = tri(e);
     double a_x = d_.coords.at(2 * start);
     double a_y = d_.coords.at(2 * start + 1);
     
-    size_t end = d_.halfedges.at(e);
+    size_t end = half(e);
     size_t coord_id;
 //    size_t end;
     if (end == delaunator::INVALID_INDEX){ // there's no opposite triangle
         // look for the start of next half edge
-        coord_id = d_.triangles.at((e % 3 == 2) ? e - 2 : e + 1);
+        coord_id = tri((e % 3 == 2) ? e - 2 : e + 1);
     }
     else {
-        coord_id = d_.triangles.at(end);
+        coord_id = tri(end);
     }
     double b_x = d_.coords.at(2 * coord_id);
     double b_y = d_.coords.at(2 * coord_id + 1);
@@ -172,7 +407,7 @@ LineSeg Mesh::edgeToLineSeg(size_t e)
 
 size_t Mesh::neighborTriag(size_t e)
 {
-    size_t opposite = d_.halfedges.at(e);
+    size_t opposite = half(e);
     size_t triag;
     if (opposite != -1){
         triag = triagOfEdge(opposite);
@@ -238,7 +473,6 @@ std::vector<size_t> Mesh::search(MeshPoint p, size_t init)
     rtn.push_back(t_now);
 //    size_t t_next;
     while (!isInTriag(p, t_now)){
-        std::cout << t_now << std::endl;
         size_t t_next = walk(p, t_now);
         t_now = t_next;
         rtn.push_back(t_now);
@@ -246,7 +480,126 @@ std::vector<size_t> Mesh::search(MeshPoint p, size_t init)
     return rtn;
 }
 
-size_t Mesh::walk(MeshPoint p, size_t t_now)
+size_t Mesh::locate(MeshPoint p, size_t init)
+{
+    TraceSpan span("Mesh::locate");
+    size_t t_now(init);
+    size_t steps(0);
+    while (!isInTriag(p, t_now)){
+        t_now = walk(p, t_now);
+        steps++;
+    }
+    span.arg("steps", steps);
+    return t_now;
+}
+
+size_t Mesh::tryLocate(MeshPoint p, size_t init)
+{
+    size_t t_now(init - (init % 3));
+    if (t_now >= numEdges()) return delaunator::INVALID_INDEX;
+    // a walk visits every triangle at most once; more steps than that means it is going in circles
+    for (size_t steps = 0; steps <= numTriag(); steps++){
+        if (isInTriag(p, t_now)) return t_now;
+        size_t e = exitEdge(p, t_now);
+        if (e == delaunator::INVALID_INDEX) return e;
+        size_t e_opposite = half(e);
+        if (e_opposite == delaunator::INVALID_INDEX) return e_opposite;
+        t_now = e_opposite - (e_opposite % 3);
+    }
+    return delaunator::INVALID_INDEX;
+}
+
+void Mesh::tryLocate(std::vector<MeshPoint>& points, std::vector<size_t>& triags, size_t lanes)
+{
+    TraceSpan span("Mesh::tryLocate(batch)");
+    size_t n = points.size();
+    triags.resize(n, 0);
+    lanes = std::max(size_t(1), std::min(lanes, n));
+    span.arg("points", double(n));
+    span.arg("lanes", double(lanes));
+    enum {TOPOLOGY, CORNERS, STEP, IDLE};
+    struct Walk
+    {
+        size_t q;      // point being located
+        size_t t;      // current triangle
+        size_t v[3];   // its corners, once read
+        size_t steps;
+        int stage;     // what to do on the next visit
+    };
+    std::vector<Walk> walks(lanes);
+    size_t next(0), active(0);
+    auto prefetchTriag = [&](size_t t){
+        if (compact_){
+            __builtin_prefetch(&tri32_[t]);
+            __builtin_prefetch(&half32_[t]);
+        } else {
+            __builtin_prefetch(&d_.triangles[t]);
+            __builtin_prefetch(&d_.halfedges[t]);
+        }
+    };
+    auto begin = [&](Walk& w){
+        if (next == n){
+            w.stage = IDLE;
+            return;
+        }
+        w.q = next++;
+        w.t = triags[w.q] - triags[w.q] % 3;
+        if (w.t >= numEdges()) w.t = 0;
+        w.steps = 0;
+        w.stage = TOPOLOGY;
+        active++;
+    };
+    auto finish = [&](Walk& w, size_t result){
+        triags[w.q] = result;
+        active--;
+        begin(w);
+    };
+    for (size_t k = 0; k < lanes; k++){
+        begin(walks[k]);
+    }
+
+    size_t max_steps = numTriag();
+    while (active > 0){
+        for (size_t k = 0; k < lanes; k++){
+            Walk& w = walks[k];
+            if (w.stage == TOPOLOGY){
+                prefetchTriag(w.t);
+                w.stage = CORNERS;
+            } else if (w.stage == CORNERS){
+                for (int j = 0; j < 3; j++){
+                    w.v[j] = tri(w.t + j);
+                    __builtin_prefetch(&coords_[2 * w.v[j]]);
+                }
+                w.stage = STEP;
+            } else if (w.stage == STEP){
+                // leave through the first edge that has p strictly on its outer side; triangles
+                // all have the orientation of signedDoubleArea, so flat ones don't hold p
+                const MeshPoint& p = points[w.q];
+                size_t exit = delaunator::INVALID_INDEX;
+                for (int j = 0; j < 3 && exit == delaunator::INVALID_INDEX; j++){
+                    const double* a = &coords_[2 * w.v[j]];
+                    const double* b = &coords_[2 * w.v[(j + 1) % 3]];
+                    double side = (b[1] - a[1]) * (p.x_ - b[0]) - (b[0] - a[0]) * (p.y_ - b[1]);
+                    if (side < 0) exit = w.t + j;
+                }
+                if (exit == delaunator::INVALID_INDEX){
+                    // NaN coordinates fail every test above; they aren't inside anything
+                    finish(w, (p.x_ == p.x_ && p.y_ == p.y_) ? w.t : delaunator::INVALID_INDEX);
+                    continue;
+                }
+                size_t h = half(exit);
+                if (h == delaunator::INVALID_INDEX || ++w.steps > max_steps){
+                    finish(w, delaunator::INVALID_INDEX); // outside the domain, or lost
+                    continue;
+                }
+                w.t = h - h % 3;
+                w.stage = TOPOLOGY;
+            }
+        }
+    }
+}
+
+size_t Mesh::exitEdge(MeshPoint p, size_t t_now)
 {
     std::vector<size_t> edges_head = edgesOfTriag(t_now);
     
@@ -260,12 +613,18 @@ size_t Mesh::walk(MeshPoint p, size_t t_now)
             intersection = e;
         }
     }
+    return intersection;
+}
+
+size_t Mesh::walk(MeshPoint p, size_t t_now)
+{
+    size_t intersection = exitEdge(p, t_now);
     try {
         if (intersection == delaunator::INVALID_INDEX){
             // no intersection found
             throw ExitException(2);
         }
-        size_t e_opposite = d_.halfedges[intersection];
+        size_t e_opposite = half(intersection);
         if (e_opposite == delaunator::INVALID_INDEX){
             // point is outside domain
             throw ExitException(3);
@@ -283,31 +642,1095 @@ size_t Mesh::walk(MeshPoint p, size_t t_now)
 
 double Mesh::interp(MeshPoint p, size_t init)
 {
-    std::vector<size_t> triag = search(p, init);
-    VecDoub bary = barycentric(p, triag.back());
-    
-    std::vector<size_t> points = pointsOfTriag(triag.back());
+    return interpInTriag(p, locate(p, init));
+}
+
+double Mesh::interpInTriag(MeshPoint p, size_t t)
+{
+    VecDoub bary = barycentric(p, t);
+    t = t - (t % 3);
     double out(0);
     for (int i=0; i<3; i++){
-        out += bary[i] * val_[points[i]];
+        out += bary[i] * val_[tri(t + i)]; // value index is the vertex index
+    }
+    return out;
+}
+
+VecDoub Mesh::deposit(std::vector<MeshPoint>& points, VecDoub& weights, unsigned int nthreads)
+{
+    TraceSpan span("Mesh::deposit");
+    if (weights.size() != points.size()){
+        try {
+            throw ExitException(1);
+        } catch (ExitException& e) {
+            std::cerr << "Found " << weights.size() << " weights for ";
+            std::cerr << points.size() << " points." << std::endl;
+            std::cout << e.what() << std::endl;
+        }
+    }
+    size_t nv = size();
+    if (nthreads == 0) nthreads = std::max(1u, std::thread::hardware_concurrency());
+    nthreads = std::max(1u, unsigned(std::min(size_t(nthreads), points.size())));
+    
+    double x_lo = coords_[0], x_hi = x_lo, y_lo = coords_[1], y_hi = y_lo;
+    for (size_t v = 1; v < nv; v++){
+        x_lo = std::min(x_lo, coords_[2 * v]);
+        x_hi = std::max(x_hi, coords_[2 * v]);
+        y_lo = std::min(y_lo, coords_[2 * v + 1]);
+        y_hi = std::max(y_hi, coords_[2 * v + 1]);
+    }
+    
+    // scatter: every thread adds its range of particles into a private buffer
+    std::vector<VecDoub> partial(nthreads);
+    size_t chunk = (points.size() + nthreads - 1) / nthreads;
+    std::vector<std::thread> workers;
+    for (unsigned int k = 0; k < nthreads; k++){
+        workers.push_back(std::thread([&, k](){
+            VecDoub& buffer = partial[k];
+            buffer.assign(nv, 0); // touched first by the thread that uses it
+            size_t i_end = std::min(points.size(), (k + 1) * chunk);
+            // go through the range along a Morton curve, so each search starts close by
+            std::vector<std::pair<uint32_t, size_t> > order;
+            for (size_t i = k * chunk; i < i_end; i++){
+                order.push_back(std::make_pair(mortonKey(points[i], x_lo, x_hi, y_lo, y_hi), i));
+            }
+            std::sort(order.begin(), order.end());
+            size_t t = 0;
+            for (size_t n = 0; n < order.size(); n++){
+                size_t i = order[n].second;
+                t = locate(points[i], t);
+                VecDoub bary = barycentric(points[i], t);
+                for (size_t j = 0; j < 3; j++){
+                    buffer[tri(t + j)] += weights[i] * bary[j];
+                }
+            }
+        }));
+    }
+    for (size_t k = 0; k < workers.size(); k++){
+        workers[k].join();
+    }
+    
+    // reduce: every thread sums one range of vertices over the buffers, in buffer order
+    VecDoub out(nv, 0);
+    size_t v_chunk = (nv + nthreads - 1) / nthreads;
+    workers.clear();
+    for (unsigned int k = 0; k < nthreads; k++){
+        workers.push_back(std::thread([&, k](){
+            size_t v_end = std::min(nv, (k + 1) * v_chunk);
+            for (size_t b = 0; b < partial.size(); b++){
+                VecDoub& buffer = partial[b];
+                for (size_t v = k * v_chunk; v < v_end; v++){
+                    out[v] += buffer[v];
+                }
+            }
+        }));
+    }
+    for (size_t k = 0; k < workers.size(); k++){
+        workers[k].join();
+    }
+    return out;
+}
+
+std::vector<TriagCrossing> Mesh::traverse(MeshPoint pa, MeshPoint pb, size_t init)
+{
+    TraceSpan span("Mesh::traverse");
+    std::vector<TriagCrossing> out;
+    size_t t = locate(pa, init);
+    traverseFrom(pa, pb, t, 0, out);
+    span.arg("crossed", out.size());
+    return out;
+}
+
+std::vector<TriagCrossing> Mesh::traverse(std::vector<MeshPoint>& path, size_t init)
+{
+    TraceSpan span("Mesh::traverse");
+    std::vector<TriagCrossing> out;
+    if (path.empty()) return out;
+    size_t t = locate(path[0], init);
+    for (size_t k = 0; k + 1 < path.size(); k++){
+        t = traverseFrom(path[k], path[k + 1], t, k, out);
+        if (out.empty() || out.back().s_out_ < k + 1){
+            // segment left the domain; find where the next one starts
+            t = locate(path[k + 1], t);
+        }
+    }
+    span.arg("crossed", out.size());
+    return out;
+}
+
+double Mesh::lineIntegral(MeshPoint pa, MeshPoint pb, size_t init)
+{
+    std::vector<TriagCrossing> crossings = traverse(pa, pb, init);
+    double out(0);
+    for (size_t i = 0; i < crossings.size(); i++){
+        out += crossings[i].integral_;
+    }
+    return out;
+}
+
+double Mesh::lineIntegral(std::vector<MeshPoint>& path, size_t init)
+{
+    std::vector<TriagCrossing> crossings = traverse(path, init);
+    double out(0);
+    for (size_t i = 0; i < crossings.size(); i++){
+        out += crossings[i].integral_;
+    }
+    return out;
+}
+
+size_t Mesh::traverseFrom(MeshPoint pa, MeshPoint pb, size_t t, double offset,
+                          std::vector<TriagCrossing>& out)
+{
+    LineSeg path(pa, pb);
+    MeshPoint diff = pb - pa;
+    double length = std::sqrt(diff.x_ * diff.x_ + diff.y_ * diff.y_);
+    
+    t = t - (t % 3);
+    double s_in(0);
+    size_t entry(delaunator::INVALID_INDEX); // edge we came in through
+    size_t steps(0);
+    while (true){
+        // the path leaves the triangle through the edge it hits furthest along
+        double s_out(-1);
+        size_t exit(delaunator::INVALID_INDEX);
+        for (size_t e = t; e < t + 3; e++){
+            if (e == entry) continue;
+            LineSeg edge = edgeToLineSeg(e);
+            MeshPoint inter = path.intersect(edge); // (s along path, u along edge)
+            if (inter.y_ >= 0 && inter.y_ <= 1 && inter.x_ > s_out){
+                s_out = inter.x_;
+                exit = e;
+            }
+        }
+        bool done = (exit == delaunator::INVALID_INDEX || s_out >= 1);
+        if (done) s_out = 1;
+        if (s_out > s_in){ // skip the zero-length pieces when passing through a vertex
+            MeshPoint p_in(pa.x_ + s_in * diff.x_, pa.y_ + s_in * diff.y_);
+            MeshPoint p_out(pa.x_ + s_out * diff.x_, pa.y_ + s_out * diff.y_);
+            TriagCrossing c;
+            c.t_ = t;
+            c.s_in_ = offset + s_in;
+            c.s_out_ = offset + s_out;
+            c.integral_ = length * (s_out - s_in) * (interpInTriag(p_in, t) + interpInTriag(p_out, t)) / 2;
+            out.push_back(c);
+        } else {
+            s_out = s_in;
+        }
+        if (done) break;
+        
+        size_t opposite = half(exit);
+        if (opposite == delaunator::INVALID_INDEX) break; // path leaves the domain
+        if (++steps > numTriag()) break; // degenerate geometry; don't cycle forever
+        t = triagOfEdge(opposite);
+        entry = opposite;
+        s_in = s_out;
+    }
+    return t;
+}
+
+VecDoub Mesh::rasterize(RasterGrid grid, double fill, unsigned int nthreads)
+{
+    TraceSpan span("Mesh::rasterize");
+    VecDoub out(grid.nx_ * grid.ny_, fill);
+    if (out.empty()) return out;
+    if (nthreads == 0) nthreads = std::max(1u, std::thread::hardware_concurrency());
+    // a grid flat along y (or x) has all its rows (columns) on one line; fill one and copy it
+    if (grid.ny_ > 1 && grid.y_max_ == grid.y_min_){
+        RasterGrid line = grid;
+        line.ny_ = 1;
+        VecDoub row = rasterize(line, fill, nthreads);
+        for (size_t j = 0; j < grid.ny_; j++){
+            std::copy(row.begin(), row.end(), out.begin() + j * grid.nx_);
+        }
+        return out;
+    }
+    if (grid.nx_ > 1 && grid.x_max_ == grid.x_min_){
+        RasterGrid line = grid;
+        line.nx_ = 1;
+        VecDoub column = rasterize(line, fill, nthreads);
+        for (size_t j = 0; j < grid.ny_; j++){
+            std::fill(out.begin() + j * grid.nx_, out.begin() + (j + 1) * grid.nx_, column[j]);
+        }
+        return out;
+    }
+    
+    // bands of rows; a few per thread to even out the load
+    size_t nbands = std::min(grid.ny_, size_t(4 * nthreads));
+    size_t rows = (grid.ny_ + nbands - 1) / nbands;
+    nbands = (grid.ny_ + rows - 1) / rows;
+    double dy = (grid.ny_ > 1) ? (grid.y_max_ - grid.y_min_) / (grid.ny_ - 1) : 1;
+    double eps = 1e-9 * dy; // the same tolerance as rasterizeBand, so no row is binned short
+    
+    // bin the triangles by the bands their row range overlaps
+    std::vector<std::vector<size_t> > bins(nbands);
+    for (size_t t = 0; t < numEdges(); t += 3){
+        double y_lo = coords_[2 * tri(t) + 1];
+        double y_hi = y_lo;
+        for (size_t e = t + 1; e < t + 3; e++){
+            double y = coords_[2 * tri(e) + 1];
+            y_lo = std::min(y_lo, y);
+            y_hi = std::max(y_hi, y);
+        }
+        double j_lo = std::ceil((y_lo - eps - grid.y_min_) / dy);
+        double j_hi = std::floor((y_hi + eps - grid.y_min_) / dy);
+        if (j_hi < 0 || j_lo > grid.ny_ - 1 || j_lo > j_hi) continue;
+        size_t b_lo = size_t(std::max(j_lo, 0.0)) / rows;
+        size_t b_hi = size_t(std::min(j_hi, double(grid.ny_ - 1))) / rows;
+        for (size_t b = b_lo; b <= b_hi; b++){
+            bins[b].push_back(t);
+        }
+    }
+    
+    // every band is written by one thread only
+    std::vector<std::thread> workers;
+    for (unsigned int k = 0; k < nthreads; k++){
+        workers.push_back(std::thread([&, k](){
+            for (size_t b = k; b < nbands; b += nthreads){
+                size_t j_end = std::min(grid.ny_, (b + 1) * rows);
+                rasterizeBand(grid, bins[b], b * rows, j_end, out);
+            }
+        }));
+    }
+    for (size_t k = 0; k < workers.size(); k++){
+        workers[k].join();
     }
     return out;
 }
 
+void Mesh::rasterizeBand(RasterGrid& grid, std::vector<size_t>& triags,
+                         size_t j_begin, size_t j_end, VecDoub& out)
+{
+    double dx = (grid.nx_ > 1) ? (grid.x_max_ - grid.x_min_) / (grid.nx_ - 1) : 1;
+    double dy = (grid.ny_ > 1) ? (grid.y_max_ - grid.y_min_) / (grid.ny_ - 1) : 1;
+    // so nodes on shared edges, or on rows through a vertex, are not lost to rounding
+    double eps = 1e-9 * dx;
+    double eps_y = 1e-9 * dy;
+    
+    for (size_t k = 0; k < triags.size(); k++){
+        size_t t = triags[k];
+        double x[3], y[3], f[3];
+        for (int i = 0; i < 3; i++){
+            size_t v = tri(t + i);
+            x[i] = coords_[2 * v];
+            y[i] = coords_[2 * v + 1];
+            f[i] = val_[v];
+        }
+        // the interpolant is the plane f = a * x + b * y + c
+        double det = (x[1] - x[0]) * (y[2] - y[0]) - (x[2] - x[0]) * (y[1] - y[0]);
+        if (det == 0) continue;
+        double a = ((f[1] - f[0]) * (y[2] - y[0]) - (f[2] - f[0]) * (y[1] - y[0])) / det;
+        double b = ((x[1] - x[0]) * (f[2] - f[0]) - (x[2] - x[0]) * (f[1] - f[0])) / det;
+        double c = f[0] - a * x[0] - b * y[0];
+        
+        double y_lo = std::min(y[0], std::min(y[1], y[2]));
+        double y_hi = std::max(y[0], std::max(y[1], y[2]));
+        double j_lo = std::max(std::ceil((y_lo - eps_y - grid.y_min_) / dy), double(j_begin));
+        double j_hi = std::min(std::floor((y_hi + eps_y - grid.y_min_) / dy), double(j_end) - 1);
+        for (double jd = j_lo; jd <= j_hi; jd++){
+            size_t j = size_t(jd);
+            double yj = grid.y_min_ + j * dy;
+            // span of the scanline inside the triangle; a row within the tolerance of a vertex
+            // is cut as if it went through it
+            double ys = std::min(std::max(yj, y_lo), y_hi);
+            double x_lo = std::numeric_limits<double>::max();
+            double x_hi = -std::numeric_limits<double>::max();
+            for (int i = 0; i < 3; i++){
+                int n = (i + 1) % 3;
+                if ((y[i] - ys) * (y[n] - ys) > 0) continue; // edge doesn't reach this row
+                if (y[i] == y[n]){
+                    x_lo = std::min(x_lo, std::min(x[i], x[n]));
+                    x_hi = std::max(x_hi, std::max(x[i], x[n]));
+                } else {
+                    double xe = x[i] + (ys - y[i]) * (x[n] - x[i]) / (y[n] - y[i]);
+                    x_lo = std::min(x_lo, xe);
+                    x_hi = std::max(x_hi, xe);
+                }
+            }
+            double i_lo = std::max(std::ceil((x_lo - eps - grid.x_min_) / dx), 0.0);
+            double i_hi = std::min(std::floor((x_hi + eps - grid.x_min_) / dx), double(grid.nx_) - 1);
+            if (i_lo > i_hi) continue;
+            size_t i_begin = size_t(i_lo);
+            size_t i_end = size_t(i_hi) + 1;
+            // step the plane along the scanline
+            double value = a * (grid.x_min_ + i_begin * dx) + b * yj + c;
+            double step = a * dx;
+            double* row = &out[j * grid.nx_];
+            for (size_t i = i_begin; i < i_end; i++){
+                row[i] = value;
+                value += step;
+            }
+        }
+    }
+}
+
+std::vector<Contour> Mesh::contours(VecDoub levels, unsigned int nthreads)
+{
+    TraceSpan span("Mesh::contours");
+    std::vector<Contour> out;
+    size_t nl = levels.size();
+    if (nl == 0 || numEdges() == 0) return out;
+    if (nthreads == 0) nthreads = std::max(1u, std::thread::hardware_concurrency());
+    
+    // levels sorted, remembering where each came from
+    std::vector<std::pair<double, size_t> > sorted(nl);
+    for (size_t l = 0; l < nl; l++){
+        sorted[l] = std::make_pair(levels[l], l);
+    }
+    std::sort(sorted.begin(), sorted.end());
+    VecDoub sorted_levels(nl);
+    for (size_t l = 0; l < nl; l++){
+        sorted_levels[l] = sorted[l].first;
+    }
+    
+    // pass 1: every thread collects (level, triangle) crossings of one range of triangles
+    size_t nt = numTriag();
+    size_t chunk = (nt + nthreads - 1) / nthreads;
+    std::vector<std::vector<std::pair<size_t, size_t> > > found(nthreads);
+    std::vector<std::thread> workers;
+    for (unsigned int k = 0; k < nthreads; k++){
+        workers.push_back(std::thread([&, k](){
+            size_t t_end = std::min(nt, (k + 1) * chunk);
+            for (size_t c = k * chunk; c < t_end; c++){
+                size_t t = 3 * c;
+                double v0 = val_[tri(t)], v1 = val_[tri(t + 1)], v2 = val_[tri(t + 2)];
+                double lo = std::min(v0, std::min(v1, v2));
+                double hi = std::max(v0, std::max(v1, v2));
+                // crossed by the levels in [lo, hi): a vertex equal to the level is below it
+                size_t l = std::lower_bound(sorted_levels.begin(), sorted_levels.end(), lo) - sorted_levels.begin();
+                for (; l < nl && sorted_levels[l] < hi; l++){
+                    found[k].push_back(std::make_pair(sorted[l].second, t));
+                }
+            }
+        }));
+    }
+    for (size_t k = 0; k < workers.size(); k++){
+        workers[k].join();
+    }
+    
+    // bucket by level; the threads went over increasing triangles, so every bucket comes out sorted
+    std::vector<std::vector<size_t> > crossed(nl);
+    for (size_t k = 0; k < found.size(); k++){
+        for (size_t j = 0; j < found[k].size(); j++){
+            crossed[found[k][j].first].push_back(found[k][j].second);
+        }
+        std::vector<std::pair<size_t, size_t> >().swap(found[k]);
+    }
+    
+    // pass 2: stitch every level on its own, the levels spread over the threads
+    std::vector<std::vector<Contour> > lines(nl);
+    workers.clear();
+    for (unsigned int k = 0; k < nthreads; k++){
+        workers.push_back(std::thread([&, k](){
+            for (size_t l = k; l < nl; l += nthreads){
+                std::vector<size_t>& ts = crossed[l];
+                std::vector<bool> visited(ts.size(), false);
+                double level = levels[l];
+                size_t e_in, e_out;
+                // open lines first, from their start on the hull; then the loops that are left
+                for (int pass = 0; pass < 2; pass++){
+                    for (size_t j = 0; j < ts.size(); j++){
+                        if (visited[j]) continue;
+                        contourEdges(ts[j], level, e_in, e_out);
+                        if (pass == 0 && half(e_in) != delaunator::INVALID_INDEX) continue;
+                        Contour line;
+                        line.level_ = level;
+                        line.closed_ = (pass == 1);
+                        line.points_.push_back(contourPoint(e_in, level));
+                        size_t pos = j;
+                        while (true){
+                            visited[pos] = true;
+                            contourEdges(ts[pos], level, e_in, e_out);
+                            size_t next = half(e_out);
+                            if (next == delaunator::INVALID_INDEX){
+                                line.points_.push_back(contourPoint(e_out, level));
+                                break;
+                            }
+                            pos = std::lower_bound(ts.begin(), ts.end(), next - next % 3) - ts.begin();
+                            if (visited[pos]) break; // back at the start of a loop
+                            line.points_.push_back(contourPoint(e_out, level));
+                        }
+                        lines[l].push_back(line);
+                    }
+                }
+            }
+        }));
+    }
+    for (size_t k = 0; k < workers.size(); k++){
+        workers[k].join();
+    }
+    for (size_t l = 0; l < nl; l++){
+        out.insert(out.end(), lines[l].begin(), lines[l].end());
+    }
+    span.arg("levels", nl);
+    span.arg("contours", out.size());
+    return out;
+}
+
+bool Mesh::contourEdges(size_t t, double level, size_t& e_in, size_t& e_out)
+{
+    t = t - (t % 3);
+    bool above[3];
+    for (size_t i = 0; i < 3; i++){
+        above[i] = val_[tri(t + i)] > level;
+    }
+    e_in = e_out = delaunator::INVALID_INDEX;
+    // going around the triangle, the line enters where the values go up and leaves where they go down
+    for (size_t i = 0; i < 3; i++){
+        size_t j = (i + 1) % 3;
+        if (!above[i] && above[j]) e_in = t + i;
+        if (above[i] && !above[j]) e_out = t + i;
+    }
+    return e_in != delaunator::INVALID_INDEX;
+}
+
+MeshPoint Mesh::contourPoint(size_t e, double level)
+{
+    size_t a = tri(e);
+    size_t b = tri((e % 3 == 2) ? e - 2 : e + 1);
+    if (b < a) std::swap(a, b); // same arithmetic from both sides of the edge
+    double s = (level - val_[a]) / (val_[b] - val_[a]);
+    return MeshPoint(coords_[2 * a] + s * (coords_[2 * b] - coords_[2 * a]),
+                     coords_[2 * a + 1] + s * (coords_[2 * b + 1] - coords_[2 * a + 1]));
+}
+
+bool Mesh::writeContours(const char* fname, std::vector<Contour>& contours)
+{
+    FILE* f = fopen(fname, "wb");
+    if (f == NULL) return false;
+    uint32_t version = 1;
+    uint64_t count = contours.size();
+    bool ok = fwrite("DCON", 1, 4, f) == 4;
+    ok = ok && fwrite(&version, sizeof(version), 1, f) == 1;
+    ok = ok && fwrite(&count, sizeof(count), 1, f) == 1;
+    VecDoub xy;
+    for (size_t k = 0; ok && k < contours.size(); k++){
+        Contour& c = contours[k];
+        uint8_t closed = c.closed_ ? 1 : 0;
+        uint64_t npoints = c.points_.size();
+        xy.resize(2 * npoints);
+        for (size_t i = 0; i < npoints; i++){
+            xy[2 * i]     = c.points_[i].x_;
+            xy[2 * i + 1] = c.points_[i].y_;
+        }
+        ok = fwrite(&c.level_, sizeof(double), 1, f) == 1;
+        ok = ok && fwrite(&closed, 1, 1, f) == 1;
+        ok = ok && fwrite(&npoints, sizeof(npoints), 1, f) == 1;
+        ok = ok && (npoints == 0 || fwrite(&xy[0], sizeof(double), xy.size(), f) == xy.size());
+    }
+    return (fclose(f) == 0) && ok;
+}
+
+VecDoub Mesh::remapFrom(Mesh& src)
+{
+    TraceSpan span("Mesh::remapFrom");
+    size_t nt = numTriag();
+    VecDoub mass(size(), 0);
+    VecDoub moment(size(), 0);
+    for (size_t t = 0; t < numEdges(); t += 3){
+        std::vector<MeshPoint> corners = coordsOfTriag(t);
+        double third = std::fabs(polygonArea(corners)) / 3;
+        for (size_t i = 0; i < 3; i++){
+            mass[tri(t + i)] += third;
+        }
+    }
+    
+    std::vector<char> queued(nt, 0);
+    std::vector<size_t> stamp(src.numTriag(), delaunator::INVALID_INDEX);
+    std::vector<size_t> overlaps;
+    std::vector<MeshPoint> src_hull = src.hullPolygon();
+    size_t hint(0);
+    for (size_t t0 = 0; t0 < numEdges(); t0 += 3){
+        if (queued[t0 / 3]) continue;
+        queued[t0 / 3] = 1;
+        std::vector<MeshPoint> corners = coordsOfTriag(t0);
+        size_t seed = remapSeed(src, corners, src_hull, hint);
+        if (seed == delaunator::INVALID_INDEX) continue; // no overlap with the source at all
+        
+        // advancing front: (target triangle, source triangle known to overlap it)
+        std::queue<std::pair<size_t, size_t> > front;
+        front.push(std::make_pair(t0, seed));
+        while (!front.empty()){
+            size_t t = front.front().first;
+            remapTriag(src, t, front.front().second, stamp, overlaps, moment);
+            front.pop();
+            for (size_t e = t; e < t + 3; e++){
+                size_t opposite = half(e);
+                if (opposite == delaunator::INVALID_INDEX) continue;
+                size_t next = triagOfEdge(opposite);
+                if (queued[next / 3]) continue;
+                // seed the neighbor from what this triangle overlapped
+                std::vector<MeshPoint> next_corners = coordsOfTriag(next);
+                double eps = 1e-12 * std::fabs(polygonArea(next_corners));
+                Polygon piece;
+                for (size_t k = 0; k < overlaps.size(); k++){
+                    clipPolygon(src.coordsOfTriag(overlaps[k]), next_corners, piece);
+                    if (std::fabs(polygonArea(piece)) > eps){
+                        front.push(std::make_pair(next, overlaps[k]));
+                        queued[next / 3] = 1;
+                        break;
+                    }
+                }
+            }
+        }
+    }
+    
+    VecDoub out(size());
+    for (size_t v = 0; v < size(); v++){
+        out[v] = (mass[v] > 0) ? moment[v] / mass[v] : std::nan("0");
+    }
+    return out;
+}
+
+size_t Mesh::remapSeed(Mesh& src, std::vector<MeshPoint>& target, std::vector<MeshPoint>& src_hull,
+                       size_t& hint)
+{
+    double eps = 1e-12 * std::fabs(polygonArea(target));
+    Polygon piece;
+    // outside the hull of src there is nothing to find; inside, the hull being convex, the
+    // centroid of the clipped target is in the overlap, and so overlaps the triangle that holds it
+    clipPolygon(target, src_hull, piece);
+    if (!(std::fabs(polygonArea(piece)) > eps)) return delaunator::INVALID_INDEX;
+    MeshPoint c(0, 0);
+    for (size_t k = 0; k < piece.size(); k++){
+        c.x_ += piece[k].x_ / piece.size();
+        c.y_ += piece[k].y_ / piece.size();
+    }
+    size_t s = src.tryLocate(c, hint);
+    if (s != delaunator::INVALID_INDEX){
+        clipPolygon(src.coordsOfTriag(s), target, piece);
+        if (std::fabs(polygonArea(piece)) > eps){
+            hint = s;
+            return s;
+        }
+    }
+
+    // round-off on a sliver; check them all
+    double x_lo = std::min(target[0].x_, std::min(target[1].x_, target[2].x_));
+    double x_hi = std::max(target[0].x_, std::max(target[1].x_, target[2].x_));
+    double y_lo = std::min(target[0].y_, std::min(target[1].y_, target[2].y_));
+    double y_hi = std::max(target[0].y_, std::max(target[1].y_, target[2].y_));
+    for (s = 0; s < src.numEdges(); s += 3){
+        std::vector<MeshPoint> corners = src.coordsOfTriag(s);
+        bool apart = true;
+        for (int i = 0; i < 3 && apart; i++){
+            apart = corners[i].x_ < x_lo || corners[i].x_ > x_hi || corners[i].y_ < y_lo || corners[i].y_ > y_hi;
+        }
+        if (apart){ // no corner in the bounding box; only a full box check tells
+            double sx_lo = std::min(corners[0].x_, std::min(corners[1].x_, corners[2].x_));
+            double sx_hi = std::max(corners[0].x_, std::max(corners[1].x_, corners[2].x_));
+            double sy_lo = std::min(corners[0].y_, std::min(corners[1].y_, corners[2].y_));
+            double sy_hi = std::max(corners[0].y_, std::max(corners[1].y_, corners[2].y_));
+            if (sx_hi < x_lo || sx_lo > x_hi || sy_hi < y_lo || sy_lo > y_hi) continue;
+        }
+        clipPolygon(corners, target, piece);
+        if (std::fabs(polygonArea(piece)) > eps){
+            hint = s;
+            return s;
+        }
+    }
+    return delaunator::INVALID_INDEX;
+}
+
+void Mesh::remapTriag(Mesh& src, size_t t, size_t seed, std::vector<size_t>& stamp,
+                      std::vector<size_t>& overlaps, VecDoub& moment)
+{
+    std::vector<MeshPoint> corners = coordsOfTriag(t);
+    double eps = 1e-12 * std::fabs(polygonArea(corners));
+    overlaps.clear();
+    std::vector<size_t> stack(1, seed);
+    stamp[seed / 3] = t;
+    Polygon piece;
+    while (!stack.empty()){
+        size_t s = stack.back();
+        stack.pop_back();
+        std::vector<MeshPoint> source = src.coordsOfTriag(s);
+        clipPolygon(source, corners, piece);
+        if (!(std::fabs(polygonArea(piece)) > eps)) continue; // only touches; don't spread from here
+        overlaps.push_back(s);
+        
+        double f[3];
+        for (int j = 0; j < 3; j++){
+            f[j] = src.val_[src.tri(s + j)];
+        }
+        // fan over the piece; on each sub triangle both the hat functions and the source field
+        // are linear, so int(g * h) = area / 12 * (sum g_a h_a + sum g_a * sum h_a)
+        for (size_t k = 1; k + 1 < piece.size(); k++){
+            MeshPoint q[3] = {piece[0], piece[k], piece[k + 1]};
+            double area = std::fabs((q[1].x_ - q[0].x_) * (q[2].y_ - q[0].y_)
+                                    - (q[2].x_ - q[0].x_) * (q[1].y_ - q[0].y_)) / 2;
+            double lambda[3][3], h[3], mu[3];
+            for (int a = 0; a < 3; a++){
+                barycentricOf(q[a], corners[0], corners[1], corners[2], lambda[a]);
+                barycentricOf(q[a], source[0], source[1], source[2], mu);
+                h[a] = mu[0] * f[0] + mu[1] * f[1] + mu[2] * f[2];
+            }
+            double sum_h = h[0] + h[1] + h[2];
+            for (int i = 0; i < 3; i++){
+                double gh = lambda[0][i] * h[0] + lambda[1][i] * h[1] + lambda[2][i] * h[2];
+                double sum_g = lambda[0][i] + lambda[1][i] + lambda[2][i];
+                moment[tri(t + i)] += area / 12 * (gh + sum_g * sum_h);
+            }
+        }
+        for (size_t e = s; e < s + 3; e++){
+            size_t opposite = src.half(e);
+            if (opposite == delaunator::INVALID_INDEX) continue;
+            size_t next = src.triagOfEdge(opposite);
+            if (stamp[next / 3] == t) continue;
+            stamp[next / 3] = t;
+            stack.push_back(next);
+        }
+    }
+}
+
+double Mesh::sumBlocks(std::function<double(size_t, size_t)> block, unsigned int nthreads)
+{
+    const size_t block_size = 4096; // triangles; fixed so the summation order never changes
+    size_t nt = numTriag();
+    size_t nblocks = (nt + block_size - 1) / block_size;
+    if (nthreads == 0) nthreads = std::max(1u, std::thread::hardware_concurrency());
+    nthreads = unsigned(std::max(size_t(1), std::min(size_t(nthreads), nblocks)));
+    
+    VecDoub sums(nblocks, 0);
+    std::vector<std::thread> workers;
+    for (unsigned int k = 0; k < nthreads; k++){
+        workers.push_back(std::thread([&, k](){
+            for (size_t b = k; b < nblocks; b += nthreads){
+                sums[b] = block(b * block_size, std::min(nt, (b + 1) * block_size));
+            }
+        }));
+    }
+    for (size_t k = 0; k < workers.size(); k++){
+        workers[k].join();
+    }
+    double out(0);
+    for (size_t b = 0; b < nblocks; b++){
+        out += sums[b];
+    }
+    return out;
+}
+
+double Mesh::area(unsigned int nthreads)
+{
+    TraceSpan span("Mesh::area");
+    return sumBlocks([this](size_t c_begin, size_t c_end){
+        // four independent partial sums, so consecutive triangles don't wait on each other
+        double lane[4] = {0, 0, 0, 0};
+        for (size_t c = c_begin; c < c_end; c++){
+            size_t a = tri(3 * c), b = tri(3 * c + 1), d = tri(3 * c + 2);
+            lane[c % 4] += doubleArea(a, b, d);
+        }
+        return ((lane[0] + lane[1]) + (lane[2] + lane[3])) / 2;
+    }, nthreads);
+}
+
+double Mesh::integral(unsigned int nthreads)
+{
+    TraceSpan span("Mesh::integral");
+    return sumBlocks([this](size_t c_begin, size_t c_end){
+        double lane[4] = {0, 0, 0, 0};
+        for (size_t c = c_begin; c < c_end; c++){
+            size_t a = tri(3 * c), b = tri(3 * c + 1), d = tri(3 * c + 2);
+            lane[c % 4] += doubleArea(a, b, d) * (val_[a] + val_[b] + val_[d]);
+        }
+        // the mean of a linear field over a triangle is the mean of the corner values
+        return ((lane[0] + lane[1]) + (lane[2] + lane[3])) / 6;
+    }, nthreads);
+}
+
+double Mesh::integral(std::vector<MeshPoint>& region, unsigned int nthreads)
+{
+    TraceSpan span("Mesh::integral");
+    if (region.size() < 3) return 0;
+    double x_lo = region[0].x_, x_hi = x_lo, y_lo = region[0].y_, y_hi = y_lo;
+    for (size_t i = 1; i < region.size(); i++){
+        x_lo = std::min(x_lo, region[i].x_);
+        x_hi = std::max(x_hi, region[i].x_);
+        y_lo = std::min(y_lo, region[i].y_);
+        y_hi = std::max(y_hi, region[i].y_);
+    }
+    return sumBlocks([&](size_t c_begin, size_t c_end){
+        double sum(0);
+        Polygon piece;
+        for (size_t c = c_begin; c < c_end; c++){
+            size_t t = 3 * c;
+            std::vector<MeshPoint> corners = coordsOfTriag(t);
+            if (std::max(corners[0].x_, std::max(corners[1].x_, corners[2].x_)) < x_lo ||
+                std::min(corners[0].x_, std::min(corners[1].x_, corners[2].x_)) > x_hi ||
+                std::max(corners[0].y_, std::max(corners[1].y_, corners[2].y_)) < y_lo ||
+                std::min(corners[0].y_, std::min(corners[1].y_, corners[2].y_)) > y_hi) continue;
+            clipPolygon(region, corners, piece);
+            if (piece.empty()) continue;
+            // area times the value at the centroid, both from the shoelace terms
+            double a2(0), cx(0), cy(0);
+            for (size_t i = 0; i < piece.size(); i++){
+                const MeshPoint& p = piece[i];
+                const MeshPoint& q = piece[(i + 1) % piece.size()];
+                double w = p.x_ * q.y_ - q.x_ * p.y_;
+                a2 += w;
+                cx += (p.x_ + q.x_) * w;
+                cy += (p.y_ + q.y_) * w;
+            }
+            if (a2 == 0) continue;
+            MeshPoint centroid(cx / (3 * a2), cy / (3 * a2));
+            sum += std::fabs(a2) / 2 * interpInTriag(centroid, t);
+        }
+        return sum;
+    }, nthreads);
+}
+
+double Mesh::integral(std::function<bool(size_t)> select, unsigned int nthreads)
+{
+    TraceSpan span("Mesh::integral");
+    return sumBlocks([&](size_t c_begin, size_t c_end){
+        double lane[4] = {0, 0, 0, 0};
+        for (size_t c = c_begin; c < c_end; c++){
+            if (!select(3 * c)) continue;
+            size_t a = tri(3 * c), b = tri(3 * c + 1), d = tri(3 * c + 2);
+            lane[c % 4] += doubleArea(a, b, d) * (val_[a] + val_[b] + val_[d]);
+        }
+        return ((lane[0] + lane[1]) + (lane[2] + lane[3])) / 6;
+    }, nthreads);
+}
+
+bool Mesh::compact()
+{
+    size_t n = numEdges();
+    if (compact_ || n >= std::numeric_limits<uint32_t>::max()) return compact_;
+    tri32_.resize(n);
+    half32_.resize(n);
+    for (size_t e = 0; e < n; e++){
+        tri32_[e] = uint32_t(d_.triangles[e]);
+        size_t h = d_.halfedges[e];
+        half32_[e] = (h == delaunator::INVALID_INDEX) ? INVALID32 : uint32_t(h);
+    }
+    // swap with empty vectors; clear() would keep the capacity
+    std::vector<size_t>().swap(d_.triangles);
+    std::vector<size_t>().swap(d_.halfedges);
+    d_.trim();
+    compact_ = true;
+    return true;
+}
+
+MeshMemory Mesh::memoryUsage()
+{
+    MeshMemory m;
+    m.coords_ = coords_.capacity() * sizeof(double);
+    m.values_ = val_.capacity() * sizeof(double);
+    m.triangles_ = d_.triangles.capacity() * sizeof(size_t) + tri32_.capacity() * sizeof(uint32_t);
+    m.halfedges_ = d_.halfedges.capacity() * sizeof(size_t) + half32_.capacity() * sizeof(uint32_t);
+    m.construction_ = d_.construction_bytes();
+    m.vertex_index_ = inedges_.capacity() * sizeof(size_t);
+    m.total_ = m.coords_ + m.values_ + m.triangles_ + m.halfedges_ + m.construction_ + m.vertex_index_;
+    return m;
+}
+
+void Mesh::buildVertexIndex()
+{
+    inedges_.assign(size(), delaunator::INVALID_INDEX);
+    for (size_t e = 0; e < numEdges(); e++){
+        size_t end = tri((e % 3 == 2) ? e - 2 : e + 1);
+        // prefer the hull edge, so the walk around a hull vertex starts at one end of its star
+        if (half(e) == delaunator::INVALID_INDEX || inedges_[end] == delaunator::INVALID_INDEX){
+            inedges_[end] = e;
+        }
+    }
+}
+
+std::vector<size_t> Mesh::neighborsOfVertex(size_t i)
+{
+    try {
+        if (inedges_.size() != size()){
+            throw ExitException(6);
+        }
+    } catch (ExitException& e) {
+        e.what();
+    }
+    std::vector<size_t> out;
+    size_t e0 = inedges_[i];
+    if (e0 == delaunator::INVALID_INDEX) return out; // duplicate point, not in the triangulation
+    size_t e = e0;
+    do {
+        out.push_back(tri(e)); // start of the incoming edge
+        e = (e % 3 == 2) ? e - 2 : e + 1; // outgoing edge in the same triangle
+        size_t opposite = half(e);
+        if (opposite == delaunator::INVALID_INDEX){
+            // reached the hull on the other side; the end of this edge is the last neighbor
+            size_t last = tri((e % 3 == 2) ? e - 2 : e + 1);
+            if (last != out.front()) out.push_back(last);
+            break;
+        }
+        e = opposite;
+    } while (e != e0);
+    return out;
+}
+
+size_t Mesh::nearestVertex(MeshPoint p, size_t init)
+{
+    size_t t = locate(p, init);
+    t = t - (t % 3);
+    size_t best = tri(t);
+    double best_dist = delaunator::dist(p.x_, p.y_, coords_[2 * best], coords_[2 * best + 1]);
+    for (size_t e = t + 1; e < t + 3; e++){
+        size_t i = tri(e);
+        double d = delaunator::dist(p.x_, p.y_, coords_[2 * i], coords_[2 * i + 1]);
+        if (d < best_dist){
+            best = i;
+            best_dist = d;
+        }
+    }
+    // greedy descent; stops on the nearest vertex in a Delaunay triangulation
+    bool moved = true;
+    while (moved){
+        moved = false;
+        std::vector<size_t> star = neighborsOfVertex(best);
+        for (size_t j = 0; j < star.size(); j++){
+            size_t i = star[j];
+            double d = delaunator::dist(p.x_, p.y_, coords_[2 * i], coords_[2 * i + 1]);
+            if (d < best_dist){
+                best = i;
+                best_dist = d;
+                moved = true;
+            }
+        }
+    }
+    return best;
+}
+
+std::vector<size_t> Mesh::nearestVertices(MeshPoint p, size_t k, size_t init)
+{
+    TraceSpan span("Mesh::nearestVertices");
+    std::vector<size_t> out;
+    if (k == 0) return out;
+    typedef std::pair<double, size_t> DistVert;
+    std::priority_queue<DistVert, std::vector<DistVert>, std::greater<DistVert> > front;
+    std::unordered_set<size_t> seen;
+    
+    size_t first = nearestVertex(p, init);
+    front.push(DistVert(delaunator::dist(p.x_, p.y_, coords_[2 * first], coords_[2 * first + 1]), first));
+    seen.insert(first);
+    while (!front.empty() && out.size() < k){
+        size_t v = front.top().second;
+        front.pop();
+        out.push_back(v);
+        std::vector<size_t> star = neighborsOfVertex(v);
+        for (size_t j = 0; j < star.size(); j++){
+            size_t i = star[j];
+            if (seen.insert(i).second){
+                front.push(DistVert(delaunator::dist(p.x_, p.y_, coords_[2 * i], coords_[2 * i + 1]), i));
+            }
+        }
+    }
+    return out;
+}
+
+VoronoiDual& Mesh::voronoi(unsigned int nthreads)
+{
+    std::lock_guard<std::mutex> lock(dual_mutex_);
+    if (!dual_.cell_ptr_.empty()) return dual_;
+    TraceSpan span("Mesh::voronoi");
+    if (inedges_.size() != size()) buildVertexIndex();
+    if (nthreads == 0) nthreads = std::max(1u, std::thread::hardware_concurrency());
+    size_t nt = numTriag();
+    size_t nv = size();
+    // runs range(k, begin, end) on nk threads over [0, n); not worth a thread for a few hundred items
+    auto parallelFor = [nthreads](size_t n, std::function<void(size_t, size_t, size_t)> range){
+        size_t nk = std::max(size_t(1), std::min(size_t(nthreads), n / 1024));
+        size_t chunk = (n + nk - 1) / nk;
+        std::vector<std::thread> workers;
+        for (size_t k = 0; k < nk; k++){
+            workers.push_back(std::thread(range, k, std::min(n, k * chunk), std::min(n, (k + 1) * chunk)));
+        }
+        for (size_t k = 0; k < workers.size(); k++){
+            workers[k].join();
+        }
+        return nk;
+    };
+
+    // Voronoi vertices. A circumcenter inside the closure of its own triangle is inside the hull;
+    // for obtuse triangles a walk decides. Failed walks only cost an unneeded clip.
+    dual_.circumcenters_.resize(nt);
+    std::vector<char> inside(nt);
+    parallelFor(nt, [&](size_t, size_t j_begin, size_t j_end){
+        for (size_t j = j_begin; j < j_end; j++){
+            size_t a = tri(3 * j), b = tri(3 * j + 1), c = tri(3 * j + 2);
+            std::pair<double, double> cc = delaunator::circumcenter(coords_[2 * a], coords_[2 * a + 1],
+                                                                    coords_[2 * b], coords_[2 * b + 1],
+                                                                    coords_[2 * c], coords_[2 * c + 1]);
+            MeshPoint p(cc.first, cc.second);
+            // flat triangles, e.g. from collinear rows of a grid, have no meaningful circumcenter
+            double da = doubleArea(a, b, c);
+            double edge = std::max(delaunator::dist(coords_[2 * a], coords_[2 * a + 1], coords_[2 * b], coords_[2 * b + 1]),
+                                   delaunator::dist(coords_[2 * a], coords_[2 * a + 1], coords_[2 * c], coords_[2 * c + 1]));
+            if (!(std::fabs(da) > 1e-10 * edge * edge)) p = MeshPoint(std::nan(""), std::nan(""));
+            dual_.circumcenters_[j] = p;
+            if (!std::isfinite(p.x_) || !std::isfinite(p.y_)){
+                inside[j] = false;
+                continue;
+            }
+            // obtuse triangles have it across the long edge, usually in the next triangle
+            size_t t = 3 * j;
+            for (int step = 0; step < 2 && t != delaunator::INVALID_INDEX; step++){
+                VecDoub bary = barycentric(p, t);
+                size_t k = std::min_element(bary.begin(), bary.end()) - bary.begin();
+                if (bary[k] > -1e-12) break;
+                t = half(t + (k + 1) % 3); // the edge opposite corner k
+                if (t != delaunator::INVALID_INDEX) t -= t % 3;
+            }
+            inside[j] = t != delaunator::INVALID_INDEX && tryLocate(p, t) != delaunator::INVALID_INDEX;
+        }
+    });
+
+    std::vector<MeshPoint> hull = hullPolygon();
+    double x_lo = hull[0].x_, x_hi = x_lo, y_lo = hull[0].y_, y_hi = y_lo;
+    for (size_t k = 1; k < hull.size(); k++){
+        x_lo = std::min(x_lo, hull[k].x_);
+        x_hi = std::max(x_hi, hull[k].x_);
+        y_lo = std::min(y_lo, hull[k].y_);
+        y_hi = std::max(y_hi, hull[k].y_);
+    }
+    double scale = 4 * std::sqrt((x_hi - x_lo) * (x_hi - x_lo) + (y_hi - y_lo) * (y_hi - y_lo));
+
+    // cells, by vertex ranges; the ranges are joined in order
+    dual_.area_.resize(nv);
+    dual_.centroid_.resize(nv);
+    std::vector<std::vector<MeshPoint> > points(nthreads);
+    std::vector<std::vector<size_t> > counts(nthreads);
+    size_t nk = parallelFor(nv, [&](size_t k, size_t i_begin, size_t i_end){
+        for (size_t i = i_begin; i < i_end; i++){
+            size_t before = points[k].size();
+            voronoiCell(i, hull, inside, scale, points[k], dual_.area_[i], dual_.centroid_[i]);
+            counts[k].push_back(points[k].size() - before);
+        }
+    });
+    std::vector<size_t> cell_ptr(1, 0);
+    cell_ptr.reserve(nv + 1);
+    dual_.cell_points_.clear();
+    for (size_t k = 0; k < nk; k++){
+        for (size_t j = 0; j < counts[k].size(); j++){
+            cell_ptr.push_back(cell_ptr.back() + counts[k][j]);
+        }
+        dual_.cell_points_.insert(dual_.cell_points_.end(), points[k].begin(), points[k].end());
+    }
+    dual_.cell_ptr_.swap(cell_ptr); // last: a non-empty cell_ptr_ marks the diagram as built
+    return dual_;
+}
+
+std::vector<MeshPoint> Mesh::hullPolygon()
+{
+    // from the half edges without an opposite
+    std::vector<size_t> hull_next(size(), delaunator::INVALID_INDEX);
+    size_t hull_start = delaunator::INVALID_INDEX;
+    for (size_t e = 0; e < numEdges(); e++){
+        if (half(e) != delaunator::INVALID_INDEX) continue;
+        hull_start = tri(e);
+        hull_next[hull_start] = tri((e % 3 == 2) ? e - 2 : e + 1);
+    }
+    std::vector<MeshPoint> hull;
+    if (hull_start == delaunator::INVALID_INDEX) return hull;
+    for (size_t v = hull_start; hull.empty() || v != hull_start; v = hull_next[v]){
+        hull.push_back(MeshPoint(coords_[2 * v], coords_[2 * v + 1]));
+    }
+    return hull;
+}
+
+void Mesh::voronoiCell(size_t i, std::vector<MeshPoint>& hull, std::vector<char>& inside, double scale,
+                       std::vector<MeshPoint>& out, double& area, MeshPoint& centroid)
+{
+    MeshPoint v(coords_[2 * i], coords_[2 * i + 1]);
+    area = 0;
+    centroid = v;
+    size_t e0 = inedges_[i];
+    if (e0 == delaunator::INVALID_INDEX) return; // duplicate point
+
+    // circumcenters around the star of i, as neighborsOfVertex goes around it; appended straight to
+    // out, since most cells need nothing else
+    size_t start = out.size();
+    bool clip = half(e0) == delaunator::INVALID_INDEX;
+    size_t e = e0;
+    size_t e_last = delaunator::INVALID_INDEX;
+    do {
+        const MeshPoint& cc = dual_.circumcenters_[e / 3];
+        clip = clip || !inside[e / 3];
+        if (std::isfinite(cc.x_) && std::isfinite(cc.y_)) out.push_back(cc);
+        size_t e_out = (e % 3 == 2) ? e - 2 : e + 1;
+        if (half(e_out) == delaunator::INVALID_INDEX){
+            e_last = e_out;
+            break;
+        }
+        e = half(e_out);
+    } while (e != e0);
+
+    if (e_last != delaunator::INVALID_INDEX){
+        // hull point: the first and last Voronoi edges are rays across the hull edges; stand in
+        // far points for them and one more further out between them, then let the clip cut back
+        size_t edges[2] = {e0, e_last};
+        MeshPoint normal[2];
+        for (int k = 0; k < 2; k++){
+            size_t a = tri(edges[k]);
+            size_t b = tri((edges[k] % 3 == 2) ? edges[k] - 2 : edges[k] + 1);
+            size_t c = tri((edges[k] % 3 == 0) ? edges[k] + 2 : edges[k] - 1);
+            double nx = coords_[2 * b + 1] - coords_[2 * a + 1];
+            double ny = coords_[2 * a] - coords_[2 * b];
+            if (nx * (coords_[2 * c] - coords_[2 * a]) + ny * (coords_[2 * c + 1] - coords_[2 * a + 1]) > 0){
+                nx = -nx;
+                ny = -ny;
+            }
+            double len = std::sqrt(nx * nx + ny * ny);
+            normal[k] = MeshPoint(nx / len, ny / len);
+        }
+        MeshPoint first = dual_.circumcenters_[e0 / 3];
+        MeshPoint last = dual_.circumcenters_[e_last / 3];
+        if (!std::isfinite(first.x_) || !std::isfinite(first.y_)) first = v;
+        if (!std::isfinite(last.x_) || !std::isfinite(last.y_)) last = v;
+        double reach = scale + std::max(delaunator::dist(first.x_, first.y_, v.x_, v.y_),
+                                        delaunator::dist(last.x_, last.y_, v.x_, v.y_));
+        MeshPoint mid(normal[0].x_ + normal[1].x_, normal[0].y_ + normal[1].y_);
+        double mid_len = std::sqrt(mid.x_ * mid.x_ + mid.y_ * mid.y_);
+        // the far points go before the first circumcenter and after the last; order is all that
+        // matters for the clip, so the first one goes at the end too
+        out.push_back(MeshPoint(last.x_ + reach * normal[1].x_, last.y_ + reach * normal[1].y_));
+        if (mid_len > 0){
+            out.push_back(MeshPoint(v.x_ + 2 * reach * mid.x_ / mid_len, v.y_ + 2 * reach * mid.y_ / mid_len));
+        }
+        out.push_back(MeshPoint(first.x_ + reach * normal[0].x_, first.y_ + reach * normal[0].y_));
+    }
+    if (clip){
+        Polygon cell(out.begin() + start, out.end()), clipped;
+        clipPolygon(cell, hull, clipped);
+        out.resize(start);
+        out.insert(out.end(), clipped.begin(), clipped.end());
+    }
+
+    // signed area and centroid in one pass; cells are stored counterclockwise
+    size_t m = out.size() - start;
+    double twice(0), cx(0), cy(0);
+    for (size_t k = 0; k < m; k++){
+        const MeshPoint& p = out[start + k];
+        const MeshPoint& q = out[start + (k + 1) % m];
+        double cross = p.x_ * q.y_ - q.x_ * p.y_;
+        twice += cross;
+        cx += (p.x_ + q.x_) * cross;
+        cy += (p.y_ + q.y_) * cross;
+    }
+    if (twice < 0) std::reverse(out.begin() + start, out.end());
+    area = std::fabs(twice) / 2;
+    if (twice != 0) centroid = MeshPoint(cx / (3 * twice), cy / (3 * twice));
+}
+
 void Mesh::printTriag(const char* fname){
     // print triangulation to file
     FILE * pFile;
     pFile = fopen (fname,"w");
-    for(std::size_t i = 0; i < d_.triangles.size(); i+=3) {
+    for(std::size_t i = 0; i < numEdges(); i+=3) {
         fprintf(pFile,
             // "[[%f, %f], [%f, %f], [%f, %f]]\n",
             "%f, %f\n %f, %f\n %f, %f\n",
-            d_.coords[2 * d_.triangles[i]],        //tx0
-            d_.coords[2 * d_.triangles[i] + 1],    //ty0
-            d_.coords[2 * d_.triangles[i + 1]],    //tx1
-            d_.coords[2 * d_.triangles[i + 1] + 1],//ty1
-            d_.coords[2 * d_.triangles[i + 2]],    //tx2
-            d_.coords[2 * d_.triangles[i + 2] + 1] //ty2
+            d_.coords[2 * tri(i)],        //tx0
+            d_.coords[2 * tri(i) + 1],    //ty0
+            d_.coords[2 * tri(i + 1)],    //tx1
+            d_.coords[2 * tri(i + 1) + 1],//ty1
+            d_.coords[2 * tri(i + 2)],    //tx2
+            d_.coords[2 * tri(i + 2) + 1] //ty2
         );
     }
     fclose(pFile);
@@ -10,9 +10,15 @@
 
 #include "delaunator.hpp"
 #include <cmath>
+#include <cstdint>
 #include <exception>
 #include <fstream>
+#include <functional>
+#include <mutex>
+#include <queue>
 #include <stdio.h>
+#include <thread>
+#include <unordered_set>
 
 typedef std::vector<double> VecDoub;
 struct MeshPoint
@@ -77,6 +83,78 @@ struct LineSeg
     bool isCross(LineSeg& line_b);
 };
 
+/**
+ *\brief One triangle crossed by a path, see Mesh::traverse
+ */
+struct TriagCrossing
+{
+    size_t t_;         ///< index of the crossed triangle
+    double s_in_;      ///< path parameter where the path enters the triangle
+    double s_out_;     ///< path parameter where the path leaves the triangle
+    double integral_;  ///< exact line integral of the interpolated field over [s_in_, s_out_]
+};
+
+/**
+ *\brief One isoline of the interpolated field, see Mesh::contours
+ */
+struct Contour
+{
+    double level_;                  ///< iso-level
+    bool closed_;                   ///< true for a loop; the last point then connects back to the first
+    std::vector<MeshPoint> points_; ///< where the isoline crosses the edges, in order
+};
+
+/**
+ *\brief Regular grid to resample a mesh onto, see Mesh::rasterize
+ *\details Grid nodes are at x_min_ + i * (x_max_ - x_min_) / (nx_ - 1), like linspace, and the
+ *          same along y. Values are stored row by row: index j * nx_ + i. With x_max_ == x_min_
+ *          (or y_max_ == y_min_) every column (row) lies on the same line.
+ */
+struct RasterGrid
+{
+    double x_min_;
+    double x_max_;
+    size_t nx_;
+    double y_min_;
+    double y_max_;
+    size_t ny_;
+};
+
+/**
+ *\brief Bytes held by a Mesh, by component; see Mesh::memoryUsage
+ */
+struct MeshMemory
+{
+    size_t coords_;        ///< coordinates
+    size_t values_;        ///< function values
+    size_t triangles_;     ///< vertex index of every half edge
+    size_t halfedges_;     ///< opposite of every half edge
+    size_t construction_;  ///< hull, hash and edge stack kept by the triangulation after the build
+    size_t vertex_index_;  ///< vertex -> half edge index, if built
+    size_t total_;
+};
+
+/**
+ *\brief Voronoi diagram of the points of a Mesh, restricted to the convex hull; see Mesh::voronoi
+ */
+struct VoronoiDual
+{
+    std::vector<MeshPoint> circumcenters_; ///< Voronoi vertices, one per triangle, index t / 3
+    std::vector<size_t> cell_ptr_;         ///< cell i is cell_points_[cell_ptr_[i], cell_ptr_[i + 1])
+    std::vector<MeshPoint> cell_points_;   ///< cell polygons, counterclockwise
+    VecDoub area_;                         ///< area of each cell
+    std::vector<MeshPoint> centroid_;      ///< centroid of each cell
+    
+    /**
+     *\brief Polygon of the cell of point i; empty for duplicate points left out of the triangulation
+     */
+    inline std::vector<MeshPoint> cell(size_t i)
+    {
+        return std::vector<MeshPoint>(cell_points_.begin() + cell_ptr_[i],
+                                      cell_points_.begin() + cell_ptr_[i + 1]);
+    }
+};
+
 class Mesh
 {
 public:
@@ -88,11 +166,84 @@ public:
      */
     Mesh(VecDoub& coords, VecDoub& val);
     
+    /**
+     *\brief Deep copy; the copy owns its points and refers to nothing in other
+     *\details The memory is written by the calling thread, so under the default first-touch policy
+     *          it ends up on that thread's NUMA node. See MeshReplicas.
+     */
+    Mesh(const Mesh& other);
+    
+    /**
+     *\brief Copy for queries only
+     *\details Like the deep copy, but without what the triangulation only needs while building
+     *          (hull, edge hash, sort order; compact frees the same) and without the Voronoi dual, which
+     *          is built again if asked for. Saves several bytes per point on every copy.
+     */
+    Mesh(const Mesh& other, bool queries_only);
+    
+    /**
+     *\brief Triangulates a new set of points in place of the current one
+     *\param coords New coordinates, as in the constructor
+     *\param val    New function values, half the size of coords
+     *\details Meant for point clouds that move every step. The coordinates, values and all the
+     *          triangulation buffers are overwritten rather than reallocated, so nothing is allocated
+     *          when the point count is the same or smaller. The sort of the previous build is the
+     *          starting point of the new one, which is nearly free when the points moved little.
+     *          Triangle indices from before the call are meaningless afterwards. A compact mesh goes
+     *          back to the normal layout; the vertex index is rebuilt if there was one.
+     */
+    void rebuild(VecDoub& coords, VecDoub& val);
+    
+    /**
+     *\brief Moves some vertices and repairs the triangulation around them
+     *\param ids Indices of the vertices to move
+     *\param xy  Their new coordinates {x1, y1, x2, y2, ...}, twice the size of ids
+     *\details Meant for points that drift a little every step, so that the triangles mostly stay
+     *          valid. The edges of the triangles around the moved vertices are checked against the
+     *          empty-circle condition and the illegal ones flipped, then the edges around every flip,
+     *          so the cost goes with the number of moved vertices and flips, not with the mesh.
+     *          The result is the same Delaunay triangulation as a rebuild would give.
+     *
+     *          Vertices are moved one after the other; a vertex that would fold a triangle over
+     *          goes in shorter steps with flips in between. If a vertex leaves the hull, a hull
+     *          vertex moves inward, or the flips don't settle, flips can't repair the mesh and the
+     *          points are triangulated again as in rebuild; so they are when more than a quarter
+     *          of them move, which is faster.
+     *
+     *          A single hull vertex moving inward (or a moved duplicate point) is enough for the
+     *          whole call to triangulate again; those are found before any flips. Callers that
+     *          want the local repair should keep their hull vertices pinned, or only move them
+     *          outward.
+     *          Flips keep the number of triangles and most triangle indices; after a new
+     *          triangulation old triangle indices are meaningless. The vertex index is built if it
+     *          isn't there and kept up to date; the Voronoi dual is dropped. A compact mesh stays
+     *          compact, but is converted to the normal layout and back, which costs O(n).
+     *\return true if flips were enough, false if the mesh was triangulated again
+     */
+    bool moveVertices(std::vector<size_t>& ids, VecDoub& xy);
+    
     /**
      *\brief Get number of coordinate pairs
      */
     size_t size();
     
+    /**
+     *\brief Coordinates of vertex i
+     */
+    MeshPoint vertex(size_t i);
+    
+    /**
+     *\brief Counter bumped whenever the points or the triangles change (rebuild, moveVertices)
+     *\details Lets anything that caches per-triangle data tell whether it is still valid.
+     */
+    size_t generation();
+    
+    /**
+     *\brief Function values on the vertices, one per coordinate pair
+     *\note May be changed in place; the triangulation doesn't depend on them.
+     */
+    VecDoub& values();
+    
     /**
      *\brief Get the number of total triangles
      */
@@ -173,6 +324,15 @@ public:
      */
     std::vector<size_t> search(MeshPoint p, size_t init);
     
+    /**
+     *\brief Same walk as search, but only returns the triangle the point is in
+     *\param p The point to search for
+     *\param init Index of the triangle to start with
+     *\note Doesn't allocate the search path; use this when the path isn't needed. Reported to
+     *      Tracer::global() as a "Mesh::locate" span with the number of steps walked.
+     */
+    size_t locate(MeshPoint p, size_t init);
+    
     /**
      *\brief Walks to the next closest triangle
      *\param p MeshPoint to locate
@@ -181,6 +341,32 @@ public:
      */
     size_t walk(MeshPoint p, size_t t_now);
     
+    /**
+     *\brief Same as locate, but reports failure instead of exiting
+     *\return Triangle containing p, or delaunator::INVALID_INDEX if p is outside the domain (or
+     *         NaN) or the walk gets lost
+     */
+    size_t tryLocate(MeshPoint p, size_t init);
+    
+    /**
+     *\brief Locates many points at once, overlapping their memory accesses
+     *\param points Query points
+     *\param triags On entry the triangle to start each walk from (out of range, e.g. a
+     *              delaunator::INVALID_INDEX from an earlier miss, starts at triangle 0); on return the
+     *              triangle containing each point, or delaunator::INVALID_INDEX as in tryLocate
+     *\param lanes  Number of walks in flight; 1 walks the points one after the other
+     *\details On a mesh larger than the cache every step of a walk waits for memory: the triangle,
+     *          then the coordinates of its corners. Here the walks of several points advance in
+     *          turn, one stage per visit: prefetch the triangle and its half edges, then read the
+     *          corners and prefetch their coordinates, then step. By the time a walk is visited again
+     *          its data has arrived, and meanwhile the others did their work. Each point costs the
+     *          same steps as alone, but the waits overlap.
+     *
+     *          Walks use orientation tests (a visibility walk), so a point on an edge may end up
+     *          in either triangle next to it.
+     */
+    void tryLocate(std::vector<MeshPoint>& points, std::vector<size_t>& triags, size_t lanes = 16);
+    
     /**
      *\brief Linear interpolation on triangular grid
      *\param p        Query point for interpolation
@@ -189,6 +375,209 @@ public:
      */
     double interp(MeshPoint p, size_t init);
     
+    /**
+     *\brief Linear interpolation of the field at point p in triangle t; no search is done
+     *\param t Triangle containing p, e.g. from locate
+     */
+    double interpInTriag(MeshPoint p, size_t t);
+    
+    /**
+     *\brief Deposits weighted points onto the vertices, the adjoint of interp
+     *\param points   Particle positions, all inside the domain
+     *\param weights  Weight (charge) of each particle
+     *\param nthreads Number of threads; 0 uses all hardware threads
+     *\return One value per vertex: the sum over the particles of weight * barycentric coordinate
+     *\details The particles are split into one contiguous range per thread. Each thread locates its
+     *          particles along a Morton curve, starting every search from the previous result, and adds into
+     *          its own per-vertex buffer; the buffers are then summed vertex range by vertex range
+     *          in thread order. No atomics, and the result only depends on the number of threads.
+     *\note Takes nthreads * size() doubles of scratch memory.
+     */
+    VecDoub deposit(std::vector<MeshPoint>& points, VecDoub& weights, unsigned int nthreads = 0);
+    
+    /**
+     *\brief Walks the line segment pa -> pb through the triangulation
+     *\param pa   Start point of the segment, has to be inside the domain
+     *\param pb   End point of the segment
+     *\param init Index of the triangle to start searching for pa in
+     *\return Every triangle crossed by the segment, in order, with the entry and exit parameters
+     *         s in [0, 1] along the segment and the line integral of the field over that piece.
+     *\details Only the starting point is searched for. After that the walk goes from the exit edge
+     *          of one triangle to its neighbor through the half edges, so the cost is one search plus
+     *          the number of crossed triangles. The walk stops where the segment leaves the domain.
+     */
+    std::vector<TriagCrossing> traverse(MeshPoint pa, MeshPoint pb, size_t init);
+    
+    /**
+     *\brief Walks a polyline through the triangulation
+     *\param path Vertices of the polyline; all of them have to be inside the domain
+     *\param init Index of the triangle to start searching for path[0] in
+     *\return Crossed triangles as in traverse(pa, pb, init). On the k-th segment the path
+     *         parameter runs from k to k + 1.
+     */
+    std::vector<TriagCrossing> traverse(std::vector<MeshPoint>& path, size_t init);
+    
+    /**
+     *\brief Line integral of the interpolated field along the segment pa -> pb
+     *\details The field is linear inside each triangle, so the integral over each crossed piece
+     *          is exact (trapezoidal rule on the piece). Integrates up to where the segment leaves the domain.
+     */
+    double lineIntegral(MeshPoint pa, MeshPoint pb, size_t init);
+    
+    /**
+     *\brief Line integral of the interpolated field along a polyline
+     */
+    double lineIntegral(std::vector<MeshPoint>& path, size_t init);
+    
+    /**
+     *\brief Resamples the interpolated field onto a regular grid
+     *\param grid     Grid to fill
+     *\param fill     Value for grid nodes outside the triangulation
+     *\param nthreads Number of threads; 0 uses all hardware threads
+     *\return Grid values, grid.nx_ * grid.ny_ of them, row by row
+     *\details Goes over the triangles instead of searching for every grid node. Each triangle fills
+     *          the nodes it covers scanline by scanline, stepping the linear interpolant by a constant
+     *          per node. Cost is O(triangles + nodes). The grid is split into bands of rows which are
+     *          filled in parallel.
+     */
+    VecDoub rasterize(RasterGrid grid, double fill, unsigned int nthreads = 0);
+    
+    /**
+     *\brief Isolines of the interpolated field (marching triangles)
+     *\param levels   Iso-levels, any number, any order
+     *\param nthreads Number of threads; 0 uses all hardware threads
+     *\return Polylines, grouped by level in the order of levels. Each runs with the higher values
+     *         on its left. Open ones start and end on the hull.
+     *\details One parallel pass over ranges of triangles finds every triangle crossed by every
+     *          level (the levels inside a triangle's value range, by binary search). The crossings
+     *          are then stitched into polylines through the half edges, the levels in parallel.
+     *          A vertex with a value equal to the level counts as below it, so the isolines never
+     *          run through vertices.
+     */
+    std::vector<Contour> contours(VecDoub levels, unsigned int nthreads = 0);
+    
+    /**
+     *\brief Writes contours to a binary file
+     *\details Layout, in host byte order: "DCON", uint32 version (1), uint64 number of contours;
+     *          then per contour double level, uint8 closed, uint64 number of points and the points
+     *          as double pairs x, y. The version doubles as a byte-order mark: on a host of the
+     *          other byte order it reads as 0x01000000, and a reader has to reject the file.
+     *\return false if the file can't be written
+     */
+    static bool writeContours(const char* fname, std::vector<Contour>& contours);
+    
+    /**
+     *\brief Conservative transfer of the field of another mesh onto the vertices of this one
+     *\param src Mesh whose field is transferred
+     *\return One value per vertex of this mesh; NaN where a vertex touches no part of src
+     *\details Intersects every triangle of this mesh with the triangles of src it overlaps and
+     *          integrates the source field against the hat function of each vertex exactly. Values
+     *          are these integrals divided by the lumped mass (area / 3 of every triangle around the
+     *          vertex), so the integral of the result equals the integral of the source field over
+     *          the overlap. The triangles of both meshes are visited as an advancing front: each
+     *          triangle is seeded from the source triangles its already processed neighbor overlapped,
+     *          which makes the transfer close to O(n + m) when the two domains coincide. Triangles
+     *          no neighbor seeds are clipped to the hull of src and located by a walk from the last
+     *          seed, so target triangles outside the source domain cost O(size of its hull) each.
+     */
+    VecDoub remapFrom(Mesh& src);
+    
+    /**
+     *\brief Area of the triangulated domain
+     *\param nthreads Number of threads; 0 uses all hardware threads
+     *\details Like all the reductions below, the triangles are summed in fixed blocks, four
+     *          independent partial sums per block, and the block sums are added up in block order.
+     *          The threads only decide who computes which block, so the result is bitwise the same
+     *          for any number of threads and any run.
+     */
+    double area(unsigned int nthreads = 0);
+    
+    /**
+     *\brief Integral of the interpolated field over the domain; divide by area() for the mean
+     */
+    double integral(unsigned int nthreads = 0);
+    
+    /**
+     *\brief Integral of the interpolated field over a polygonal region
+     *\param region Polygon, any orientation, need not be convex. Parts outside the domain count as 0.
+     *\details Every triangle overlapping the bounding box of region is intersected with it; the
+     *          field is linear on each piece, so a piece contributes its area times the value at its
+     *          centroid. Exact up to rounding.
+     */
+    double integral(std::vector<MeshPoint>& region, unsigned int nthreads = 0);
+    
+    /**
+     *\brief Integral of the interpolated field over the triangles t with select(t) true
+     *\note select is called from several threads at once.
+     */
+    double integral(std::function<bool(size_t)> select, unsigned int nthreads = 0);
+    
+    /**
+     *\brief Switches the mesh to the compact layout
+     *\details Stores the triangles and half edges as 32-bit indices and frees what the triangulation
+     *          only needed while it was being built (hull links, edge hash, edge stack). Queries work
+     *          the same afterwards. Roughly halves the topology memory.
+     *\return true if the mesh is compact; false if it has too many half edges for 32-bit indices
+     */
+    bool compact();
+    
+    /**
+     *\brief Memory held by the mesh, by component
+     *\note Counts vector capacities, so this is what is resident, not just what is used.
+     */
+    MeshMemory memoryUsage();
+    
+    /**
+     *\brief Builds the vertex -> half edge index used by the vertex queries below
+     *\details For every vertex stores one half edge that ends on it. For vertices on the hull the
+     *          incoming hull edge is chosen, so that rotating around the vertex from there visits the
+     *          whole star. Optional; only needed for neighborsOfVertex and the nearest-vertex queries.
+     */
+    void buildVertexIndex();
+    
+    /**
+     *\brief Indices of the vertices connected to vertex i by an edge, in rotational order
+     *\param i index of the vertex
+     *\note Requires buildVertexIndex(). Returns nothing for duplicate points that were left out
+     *      of the triangulation.
+     */
+    std::vector<size_t> neighborsOfVertex(size_t i);
+    
+    /**
+     *\brief Index of the vertex closest to p
+     *\param p    Query point, has to be inside the domain
+     *\param init Index of the triangle to start searching in
+     *\details Searches for the triangle containing p, then steps greedily to closer neighbors.
+     *          In a Delaunay triangulation this always ends on the nearest vertex.
+     */
+    size_t nearestVertex(MeshPoint p, size_t init);
+    
+    /**
+     *\brief Indices of the k vertices closest to p, nearest first
+     *\param p    Query point, has to be inside the domain
+     *\param k    Number of vertices to return
+     *\param init Index of the triangle to start searching in
+     *\details Best-first expansion through the vertex stars from the nearest vertex. The vertices
+     *          within any distance of p are connected in the Delaunay graph, so this is exact.
+     */
+    std::vector<size_t> nearestVertices(MeshPoint p, size_t k, size_t init);
+    
+    /**
+     *\brief Voronoi diagram of the points, as the dual of the triangulation
+     *\param nthreads Number of threads; 0 uses all hardware threads
+     *\details Built on the first call and kept until the triangulation changes. The circumcenters
+     *          of the triangles are the Voronoi vertices; the cell of a point joins the circumcenters
+     *          around its vertex star, in the order found through the half edges. Cells are clipped
+     *          to the convex hull, so the areas add up to the area of the domain; cells of hull
+     *          points are closed by the hull. Builds the vertex index if it isn't there.
+     *
+     *          Threads sharing the mesh may call it at the same time: the check and the build run
+     *          under a lock, so the first caller builds and the others wait for it. Like every
+     *          query, it must not overlap rebuild or moveVertices.
+     *\return Reference to the cached diagram, valid until the next rebuild
+     */
+    VoronoiDual& voronoi(unsigned int nthreads = 0);
+    
     /**
      * \brief print the coordiantes of the triangles to file
      * \param fname name of file to output to
@@ -196,9 +585,162 @@ public:
     void printTriag(const char* fname);
     
 private:
-    delaunator::Delaunator d_;
+    /**
+     *\brief Edge of t crossed by the line from the centroid of t to p
+     *\return delaunator::INVALID_INDEX if there is none
+     */
+    size_t exitEdge(MeshPoint p, size_t t_now);
+    
+    /**
+     *\brief Walks one segment, starting from triangle t which contains pa. Appends to out.
+     *\param offset Added to the path parameters, for numbering the segments of a polyline
+     *\return Index of the last triangle visited
+     */
+    size_t traverseFrom(MeshPoint pa, MeshPoint pb, size_t t, double offset,
+                        std::vector<TriagCrossing>& out);
+    
+    /**
+     *\brief Source triangle of src overlapping the given triangle
+     *\param src_hull Hull of src, see hullPolygon
+     *\param hint     Where to start looking in src; receives the triangle found
+     *\details Clips the target to the hull of src and locates a point of what is left, walking
+     *          from hint; checks all source triangles only if round-off gets in the way. Costs
+     *          O(hull size) plus the walk.
+     *\return Index of the source triangle, or delaunator::INVALID_INDEX if none overlaps
+     */
+    size_t remapSeed(Mesh& src, std::vector<MeshPoint>& target, std::vector<MeshPoint>& src_hull,
+                     size_t& hint);
+    
+    /**
+     *\brief Integrates the source field against the hat functions of triangle t
+     *\param seed     A source triangle overlapping t
+     *\param stamp    Per source triangle, the last target triangle that visited it
+     *\param overlaps Receives the source triangles overlapping t
+     *\param moment   Integrals of hat function times source field, per vertex of this mesh
+     */
+    void remapTriag(Mesh& src, size_t t, size_t seed, std::vector<size_t>& stamp,
+                    std::vector<size_t>& overlaps, VecDoub& moment);
+    
+    /**
+     *\brief Sums block(t_begin, t_end) over fixed blocks of triangles, deterministically; see area
+     */
+    double sumBlocks(std::function<double(size_t, size_t)> block, unsigned int nthreads);
+    
+    /**
+     *\brief Half edges where the isoline at level enters and leaves triangle t
+     *\return false if the level doesn't cross t
+     */
+    bool contourEdges(size_t t, double level, size_t& e_in, size_t& e_out);
+    
+    /**
+     *\brief Where the isoline at level crosses half edge e; the same for e and its opposite
+     */
+    MeshPoint contourPoint(size_t e, double level);
+    
+    /**
+     *\brief Fills the rows [j_begin, j_end) of the raster from the given triangles
+     */
+    void rasterizeBand(RasterGrid& grid, std::vector<size_t>& triags,
+                       size_t j_begin, size_t j_end, VecDoub& out);
+    
+    /**
+     *\brief Cell of vertex i for voronoi: appends its polygon to out and fills in area and centroid
+     *\param hull   Convex hull polygon, to clip against
+     *\param inside Whether each circumcenter is inside the hull
+     *\param scale  A length larger than the domain, to stand in for the unbounded edges of hull cells
+     */
+    void voronoiCell(size_t i, std::vector<MeshPoint>& hull, std::vector<char>& inside, double scale,
+                     std::vector<MeshPoint>& out, double& area, MeshPoint& centroid);
+    
+    /**
+     *\brief Moves vertex i to p for moveVertices, flipping edges on the way
+     *\param flipped Receives the half edges of every flip
+     *\note moveVertices has already checked that i is in the triangulation and that the hull
+     *      stays convex.
+     *\return false if flips can't get it there; the triangulation then needs an update
+     */
+    bool moveVertex(size_t i, MeshPoint p, std::vector<size_t>& flipped);
+    
+    /**
+     *\brief Points the vertex index away from half edges that flips moved
+     *\param flipped Half edges of the flips, see delaunator::Delaunator::relegalize; from first on
+     */
+    void refreshVertexIndex(std::vector<size_t>& flipped, size_t first);
+    
+    /**
+     *\brief Whether the triangles around vertex i all keep the orientation of the triangulation
+     *\param edges Receives their half edges
+     */
+    bool starValid(size_t i, std::vector<size_t>& edges);
+    
+    /**
+     *\brief Corners of the convex hull of the triangulation, in the triangles' orientation
+     */
+    std::vector<MeshPoint> hullPolygon();
+    
+    /**
+     *\brief Whether the hull is still convex at vertex i and its two hull neighbors; true inside
+     */
+    bool hullConvex(size_t i);
+    
+    /**
+     *\brief Twice the signed area of the triangle a, b, d; positive in the orientation of the
+     *        triangulation's triangles
+     */
+    inline double signedDoubleArea(size_t a, size_t b, size_t d)
+    {
+        return (coords_[2 * b + 1] - coords_[2 * a + 1]) * (coords_[2 * d] - coords_[2 * b])
+             - (coords_[2 * b] - coords_[2 * a]) * (coords_[2 * d + 1] - coords_[2 * b + 1]);
+    }
+    
+    /**
+     *\brief Start vertex of half edge e, in either layout
+     */
+    inline size_t tri(size_t e)
+    {
+        return compact_ ? tri32_[e] : d_.triangles[e];
+    }
+    
+    /**
+     *\brief Opposite half edge of e, or delaunator::INVALID_INDEX on the hull, in either layout
+     */
+    inline size_t half(size_t e)
+    {
+        if (!compact_) return d_.halfedges[e];
+        uint32_t h = half32_[e];
+        return (h == INVALID32) ? delaunator::INVALID_INDEX : h;
+    }
+    
+    /**
+     *\brief Number of half edges (three per triangle)
+     */
+    inline size_t numEdges()
+    {
+        return compact_ ? tri32_.size() : d_.triangles.size();
+    }
+    
+    /**
+     *\brief Twice the unsigned area of the triangle with corners a, b, d (vertex indices)
+     */
+    inline double doubleArea(size_t a, size_t b, size_t d)
+    {
+        return std::fabs((coords_[2 * b] - coords_[2 * a]) * (coords_[2 * d + 1] - coords_[2 * a + 1])
+                       - (coords_[2 * d] - coords_[2 * a]) * (coords_[2 * b + 1] - coords_[2 * a + 1]));
+    }
+    
+    static const uint32_t INVALID32 = 0xffffffff; // no opposite half edge, compact layout
+    
+    // coords_ comes before d_: the triangulation keeps a reference to it
     VecDoub coords_;
     VecDoub val_; //length is half of the length of coords; Value on each grid point
+    delaunator::Delaunator d_;
+    bool compact_; // topology lives in tri32_ / half32_ instead of d_
+    std::vector<uint32_t> tri32_;
+    std::vector<uint32_t> half32_;
+    std::vector<size_t> inedges_; // one incoming half edge per vertex; empty until buildVertexIndex
+    VoronoiDual dual_;            // empty until voronoi
+    std::mutex dual_mutex_;       // held while voronoi checks or builds dual_; not copied
+    size_t generation_;           // changes with the triangles; see generation
 };
 
 /**
@@ -232,6 +774,42 @@ struct ExitException : public std::exception {
                 std::cerr << "Edge index out of range." << std::endl;
                 std::cerr << "Called by Mesh::triagOfEdge" << std::endl;
                 exit(5);
+            case 6:
+                std::cerr << "Vertex index not built." << std::endl;
+                std::cerr << "Call Mesh::buildVertexIndex first." << std::endl;
+                exit(6);
+            case 7:
+                std::cerr << "Shards are not built." << std::endl;
+                std::cerr << "Call ShardedMesh::buildLocal or ShardedMesh::serve first." << std::endl;
+                exit(7);
+            case 8:
+                std::cerr << "Lost connection to a shard process." << std::endl;
+                std::cerr << "Called by ShardedMesh" << std::endl;
+                exit(8);
+            case 9:
+                std::cerr << "Coordinates are not a rectilinear grid in meshgrid order." << std::endl;
+                std::cerr << "Called by StructuredMesh" << std::endl;
+                exit(9);
+            case 10:
+                std::cerr << "Axis is not strictly increasing, or the period is too short." << std::endl;
+                std::cerr << "Called by ExtrudedMesh" << std::endl;
+                exit(10);
+            case 11:
+                std::cerr << "Streamed points go back in x: chunks have to be sorted." << std::endl;
+                std::cerr << "Called by StreamingTriangulator::addChunk" << std::endl;
+                exit(11);
+            case 12:
+                std::cerr << "Vertex index out of range." << std::endl;
+                std::cerr << "Called by Mesh::moveVertices" << std::endl;
+                exit(12);
+            case 13:
+                std::cerr << "The mesh changed since the cache was built; call update first." << std::endl;
+                std::cerr << "Called by CloughTocher" << std::endl;
+                exit(13);
+            case 14:
+                std::cerr << "The points of the mesh changed since the replicas were made." << std::endl;
+                std::cerr << "Called by MeshReplicas::refreshValues" << std::endl;
+                exit(14);
         }
         return "Uncaught exceptions";
    }
@@ -0,0 +1,62 @@
+//  MeshCursor.cpp
+//  delta_xcode
+//
+
+#include "MeshCursor.hpp"
+#include <algorithm>
+
+MeshCursor::MeshCursor(Mesh& mesh, size_t init, size_t history)
+    :mesh_(mesh), recent_(std::max(history, size_t(1)), init), last_(0), generation_(mesh.generation())
+{
+    // nothing else to do
+}
+
+size_t MeshCursor::start(MeshPoint p)
+{
+    if (mesh_.generation() != generation_){
+        // the triangles remembered may be gone
+        reset(0);
+    }
+    size_t best = recent_[last_];
+    if (recent_.size() == 1) return best;
+    MeshPoint c = mesh_.centroid(best);
+    double best_dist = delaunator::dist(p.x_, p.y_, c.x_, c.y_);
+    for (size_t k = 0; k < recent_.size(); k++){
+        if (recent_[k] == best) continue;
+        c = mesh_.centroid(recent_[k]);
+        double d = delaunator::dist(p.x_, p.y_, c.x_, c.y_);
+        if (d < best_dist){
+            best = recent_[k];
+            best_dist = d;
+        }
+    }
+    return best;
+}
+
+size_t MeshCursor::locate(MeshPoint p)
+{
+    size_t t = mesh_.locate(p, start(p));
+    if (t != recent_[last_]){
+        // the history holds distinct places, not repeats of the same triangle
+        last_ = (last_ + 1) % recent_.size();
+        recent_[last_] = t;
+    }
+    return t;
+}
+
+double MeshCursor::interp(MeshPoint p)
+{
+    return mesh_.interpInTriag(p, locate(p));
+}
+
+size_t MeshCursor::triangle()
+{
+    return recent_[last_];
+}
+
+void MeshCursor::reset(size_t t)
+{
+    std::fill(recent_.begin(), recent_.end(), t);
+    last_ = 0;
+    generation_ = mesh_.generation();
+}
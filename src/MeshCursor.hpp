@@ -0,0 +1,68 @@
+//  MeshCursor.hpp
+//  delta_xcode
+//
+//  Per-caller search state for repeated queries on a shared Mesh
+//
+
+#ifndef mesh_cursor_h
+#define mesh_cursor_h
+
+#include "Mesh.hpp"
+
+/**
+ *\brief Remembers where the last queries on a Mesh ended, so the next search starts close by
+ *\details Consecutive queries of one particle, thread or stream are usually close together, so
+ *          starting the walk from the previous result makes a search amortized O(1). A cursor does
+ *          that bookkeeping: it keeps the last few triangles found and starts each walk from the
+ *          one whose centroid is closest to the query point, which also helps when a stream jumps
+ *          back and forth between a few regions.
+ *
+ *          The cursor only reads the mesh. Give every thread (or particle) its own cursor; one
+ *          cursor must not be used by two threads at a time.
+ *
+ *          Triangle indices don't survive Mesh::rebuild (nor a retriangulating Mesh::moveVertices).
+ *          The cursor notices through Mesh::generation and starts over from triangle 0, so it
+ *          stays usable across them; it must not be queried while they run.
+ */
+class MeshCursor
+{
+public:
+    /**
+     *\brief Cursor on mesh, starting at triangle init
+     *\param history Number of recent triangles to choose the start of a walk from; at least 1
+     */
+    MeshCursor(Mesh& mesh, size_t init = 0, size_t history = 4);
+
+    /**
+     *\brief Triangle containing p, see Mesh::locate
+     */
+    size_t locate(MeshPoint p);
+
+    /**
+     *\brief Linear interpolation at p, see Mesh::interp
+     */
+    double interp(MeshPoint p);
+
+    /**
+     *\brief Triangle found by the last query
+     */
+    size_t triangle();
+
+    /**
+     *\brief Forgets the history and starts over from triangle t, of the mesh as it is now
+     */
+    void reset(size_t t);
+
+private:
+    /**
+     *\brief Triangle among the recent ones to start walking to p from
+     */
+    size_t start(MeshPoint p);
+
+    Mesh& mesh_;
+    std::vector<size_t> recent_;  // ring buffer of triangles found
+    size_t last_;                 // slot in recent_ of the last one
+    size_t generation_;           // of the mesh the triangles in recent_ belong to
+};
+
+#endif /* mesh_cursor_h */
@@ -0,0 +1,146 @@
+//  MeshReplicas.cpp
+//  delta_xcode
+//
+
+#include "MeshReplicas.hpp"
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#ifdef __linux__
+#include <sched.h>
+#endif
+
+// parses a kernel cpu list such as "0-3,8-11"
+static std::vector<int> parseCpuList(const std::string& text)
+{
+    std::vector<int> cpus;
+    std::stringstream ss(text);
+    std::string range;
+    while (std::getline(ss, range, ',')){
+        int lo, hi;
+        char dash;
+        std::stringstream rs(range);
+        if (!(rs >> lo)) continue;
+        if (!(rs >> dash >> hi) || dash != '-') hi = lo;
+        for (int c = lo; c <= hi; c++){
+            cpus.push_back(c);
+        }
+    }
+    return cpus;
+}
+
+std::vector<std::vector<int> > MeshReplicas::numaNodes()
+{
+    std::vector<std::vector<int> > nodes;
+#ifdef __linux__
+    // node numbers may have gaps; stop after a run of missing ones
+    for (int k = 0, missing = 0; missing < 64; k++){
+        std::ostringstream name;
+        name << "/sys/devices/system/node/node" << k << "/cpulist";
+        std::ifstream f(name.str().c_str());
+        std::string text;
+        if (!f || !std::getline(f, text)){
+            missing++;
+            continue;
+        }
+        missing = 0;
+        std::vector<int> cpus = parseCpuList(text);
+        if (!cpus.empty()) nodes.push_back(cpus); // memory-only nodes get no replica
+    }
+#endif
+    if (nodes.empty()) nodes.push_back(std::vector<int>());
+    return nodes;
+}
+
+MeshReplicas::MeshReplicas(Mesh& mesh, std::vector<std::vector<int> > nodes)
+    :mesh_(mesh), nodes_(nodes)
+{
+    if (nodes_.empty()) nodes_.push_back(std::vector<int>());
+    for (size_t k = 0; k < nodes_.size(); k++){
+        for (size_t i = 0; i < nodes_[k].size(); i++){
+            size_t c = nodes_[k][i];
+            if (c >= node_of_cpu_.size()) node_of_cpu_.resize(c + 1, 0);
+            node_of_cpu_[c] = k;
+        }
+    }
+    if (nodes_.size() == 1) return;
+
+    // the copies are made concurrently, each by a thread pinned to its node
+    TraceSpan span("MeshReplicas::copy");
+    span.arg("nodes", double(nodes_.size()));
+    replicas_.resize(nodes_.size(), nullptr);
+    std::vector<std::thread> workers;
+    for (size_t k = 0; k < nodes_.size(); k++){
+        workers.push_back(std::thread([&, k](){
+            pinToNode(k);
+            replicas_[k] = new Mesh(mesh_, true); // nothing but what queries read
+        }));
+    }
+    for (size_t k = 0; k < workers.size(); k++){
+        workers[k].join();
+    }
+}
+
+MeshReplicas::~MeshReplicas()
+{
+    for (size_t k = 0; k < replicas_.size(); k++){
+        delete replicas_[k];
+    }
+}
+
+size_t MeshReplicas::numNodes()
+{
+    return nodes_.size();
+}
+
+Mesh& MeshReplicas::replica(size_t k)
+{
+    if (replicas_.empty()) return mesh_;
+    return *replicas_[k % replicas_.size()];
+}
+
+Mesh& MeshReplicas::local()
+{
+    return replica(currentNode());
+}
+
+size_t MeshReplicas::currentNode()
+{
+#ifdef __linux__
+    int c = sched_getcpu();
+    if (c >= 0 && size_t(c) < node_of_cpu_.size()) return node_of_cpu_[c];
+#endif
+    return 0;
+}
+
+bool MeshReplicas::pinToNode(size_t k)
+{
+    if (k >= nodes_.size() || nodes_[k].empty()) return false;
+#ifdef __linux__
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (size_t i = 0; i < nodes_[k].size(); i++){
+        if (nodes_[k][i] < CPU_SETSIZE) CPU_SET(nodes_[k][i], &set);
+    }
+    return sched_setaffinity(0, sizeof(set), &set) == 0;
+#else
+    return false;
+#endif
+}
+
+void MeshReplicas::refreshValues()
+{
+    VecDoub& val = mesh_.values();
+    for (size_t k = 0; k < replicas_.size(); k++){
+        // the values' pages were placed when the replica was made; copying in place keeps them there
+        VecDoub& dest = replicas_[k]->values();
+        try {
+            if (val.size() != dest.size() || mesh_.generation() != replicas_[k]->generation()){
+                throw ExitException(14);
+            }
+        } catch (ExitException& e) {
+            e.what();
+        }
+        std::copy(val.begin(), val.end(), dest.begin());
+    }
+}
@@ -0,0 +1,87 @@
+//  MeshReplicas.hpp
+//  delta_xcode
+//
+//  One copy of a Mesh per NUMA node, so that query threads only read local memory
+//
+
+#ifndef mesh_replicas_h
+#define mesh_replicas_h
+
+#include "Mesh.hpp"
+
+/**
+ *\brief Read-only copies of a Mesh, one per NUMA node
+ *\details Each copy (points, values, triangles, half edges and the vertex index if it was built) is
+ *          made by a thread pinned to the CPUs of its node, so under the default first-touch policy
+ *          its pages are allocated there. A query thread pinned to a node then walks the mesh
+ *          without remote memory accesses. On a single node nothing is copied and every replica is
+ *          the original mesh.
+ *
+ *          The nodes are read from /sys/devices/system/node on Linux; elsewhere there is one node
+ *          and threads are not pinned.
+ *\note The replicas are snapshots: values changed on the original only reach them through
+ *      refreshValues, and a rebuild of the original needs new replicas.
+ */
+class MeshReplicas
+{
+public:
+    /**
+     *\brief CPUs of each NUMA node of this machine; a single node with no CPUs listed if unknown
+     */
+    static std::vector<std::vector<int> > numaNodes();
+
+    /**
+     *\brief Copies the mesh onto every node
+     *\param mesh  Mesh to copy; has to outlive the replicas on a single node
+     *\param nodes CPUs of each node to place a copy on; by default all nodes of the machine
+     */
+    MeshReplicas(Mesh& mesh, std::vector<std::vector<int> > nodes = numaNodes());
+
+    ~MeshReplicas();
+
+    /**
+     *\brief Number of nodes, and replicas
+     */
+    size_t numNodes();
+
+    /**
+     *\brief Replica placed on node k
+     */
+    Mesh& replica(size_t k);
+
+    /**
+     *\brief Replica on the node the calling thread is running on right now
+     *\note Only stays local if the thread is pinned; see pinToNode.
+     */
+    Mesh& local();
+
+    /**
+     *\brief Node the calling thread is running on
+     */
+    size_t currentNode();
+
+    /**
+     *\brief Restricts the calling thread to the CPUs of node k
+     *\return false if the node has no CPUs listed or the affinity can't be set
+     */
+    bool pinToNode(size_t k);
+
+    /**
+     *\brief Copies the values of the original mesh into every replica
+     *\details Exits if the original was rebuilt or its vertices moved since the replicas were
+     *          made; it needs new replicas then. Must not run while queries read the replicas,
+     *          such as the workers of a QueryService: they would race with the copy.
+     */
+    void refreshValues();
+
+private:
+    MeshReplicas(const MeshReplicas&);
+    MeshReplicas& operator=(const MeshReplicas&);
+
+    Mesh& mesh_;
+    std::vector<std::vector<int> > nodes_;
+    std::vector<Mesh*> replicas_;   // empty on a single node
+    std::vector<size_t> node_of_cpu_;
+};
+
+#endif /* mesh_replicas_h */
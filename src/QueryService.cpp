@@ -0,0 +1,172 @@
+//  QueryService.cpp
+//  delta_xcode
+//
+
+#include "QueryService.hpp"
+#include "Geometry.hpp"
+#include "MeshCursor.hpp"
+#include <algorithm>
+#include <chrono>
+
+QueryService::QueryService(Mesh& mesh, QueryConfig config)
+    :mesh_(mesh), config_(config), replicas_(nullptr), head_(&stub_), tail_(&stub_),
+     pending_(0), answered_(0), batches_(0), stop_(false)
+{
+    stub_.next_.store(nullptr);
+    consuming_.clear();
+    if (config_.max_batch_ == 0) config_.max_batch_ = 1;
+    if (config_.numa_replicas_) replicas_ = new MeshReplicas(mesh_);
+    unsigned int n = config_.nworkers_;
+    if (n == 0) n = std::max(1u, std::thread::hardware_concurrency());
+    for (unsigned int k = 0; k < n; k++){
+        workers_.push_back(std::thread(&QueryService::work, this, k));
+    }
+}
+
+QueryService::~QueryService()
+{
+    stop_.store(true);
+    wake_.notify_all();
+    for (size_t k = 0; k < workers_.size(); k++){
+        workers_[k].join();
+    }
+    delete replicas_;
+}
+
+std::future<double> QueryService::submit(MeshPoint p)
+{
+    Request* r = new Request;
+    r->p_ = p;
+    std::future<double> out = r->promise_.get_future();
+    push(r);
+    return out;
+}
+
+void QueryService::submit(MeshPoint p, std::function<void(double)> callback)
+{
+    Request* r = new Request;
+    r->p_ = p;
+    r->callback_ = callback;
+    push(r);
+}
+
+size_t QueryService::answered()
+{
+    return answered_.load();
+}
+
+size_t QueryService::batches()
+{
+    return batches_.load();
+}
+
+void QueryService::enqueue(Request* r)
+{
+    r->next_.store(nullptr, std::memory_order_relaxed);
+    Request* prev = head_.exchange(r, std::memory_order_acq_rel);
+    prev->next_.store(r, std::memory_order_release);
+}
+
+void QueryService::push(Request* r)
+{
+    // counted before it is linked, so a worker can't take it off the queue and count it down
+    // first, wrapping the counter; wake a worker once a full batch is waiting, otherwise the
+    // latency timeout picks it up
+    bool full = pending_.fetch_add(1) + 1 == config_.max_batch_;
+    enqueue(r);
+    if (full){
+        wake_.notify_one();
+    }
+}
+
+QueryService::Request* QueryService::pop()
+{
+    Request* tail = tail_;
+    Request* next = tail->next_.load(std::memory_order_acquire);
+    if (tail == &stub_){
+        if (next == nullptr) return nullptr;
+        tail_ = next;
+        tail = next;
+        next = next->next_.load(std::memory_order_acquire);
+    }
+    if (next != nullptr){
+        tail_ = next;
+        return tail;
+    }
+    if (tail != head_.load(std::memory_order_acquire)) return nullptr; // push in progress
+    // tail is the last request; put the stub behind it so it can be handed out
+    enqueue(&stub_);
+    next = tail->next_.load(std::memory_order_acquire);
+    if (next != nullptr){
+        tail_ = next;
+        return tail;
+    }
+    return nullptr;
+}
+
+void QueryService::work(unsigned int k)
+{
+    Mesh* mesh = &mesh_;
+    if (replicas_ != nullptr){
+        size_t node = k % replicas_->numNodes();
+        replicas_->pinToNode(node);
+        mesh = &replicas_->replica(node);
+    }
+    std::chrono::duration<double> latency(config_.max_latency_);
+    std::vector<Request*> batch;
+    std::vector<std::pair<uint32_t, size_t> > order; // (Morton key, position in batch)
+    MeshCursor cursor(*mesh, 0, 1); // batches are Morton sorted; the last triangle is the best start
+    while (true){
+        if (pending_.load() < config_.max_batch_ && !stop_.load()){
+            std::unique_lock<std::mutex> lock(sleep_mutex_);
+            wake_.wait_for(lock, latency, [this](){
+                return pending_.load() >= config_.max_batch_ || stop_.load();
+            });
+        }
+
+        batch.clear();
+        if (!consuming_.test_and_set(std::memory_order_acquire)){
+            Request* r;
+            while (batch.size() < config_.max_batch_ && (r = pop()) != nullptr){
+                batch.push_back(r);
+            }
+            consuming_.clear(std::memory_order_release);
+        }
+        if (batch.empty()){
+            if (stop_.load() && pending_.load() == 0) break;
+            // another worker is consuming, or a producer is between counting and linking its
+            // request; let them run instead of spinning on the queue
+            if (pending_.load() > 0) std::this_thread::yield();
+            continue;
+        }
+        pending_.fetch_sub(batch.size());
+        if (pending_.load() >= config_.max_batch_) wake_.notify_one(); // more full batches waiting
+
+        // sort along a Morton curve over the batch's bounding box, so consecutive walks are short
+        double x_lo = batch[0]->p_.x_, x_hi = x_lo, y_lo = batch[0]->p_.y_, y_hi = y_lo;
+        for (size_t k = 1; k < batch.size(); k++){
+            x_lo = std::min(x_lo, batch[k]->p_.x_);
+            x_hi = std::max(x_hi, batch[k]->p_.x_);
+            y_lo = std::min(y_lo, batch[k]->p_.y_);
+            y_hi = std::max(y_hi, batch[k]->p_.y_);
+        }
+        order.resize(batch.size());
+        for (size_t k = 0; k < batch.size(); k++){
+            order[k] = std::make_pair(mortonKey(batch[k]->p_, x_lo, x_hi, y_lo, y_hi), k);
+        }
+        std::sort(order.begin(), order.end());
+
+        for (size_t k = 0; k < order.size(); k++){
+            Request* r = batch[order[k].second];
+            double value = cursor.interp(r->p_);
+            if (r->callback_){
+                r->callback_(value);
+            } else {
+                r->promise_.set_value(value);
+            }
+            delete r;
+        }
+        answered_.fetch_add(batch.size());
+        batches_.fetch_add(1);
+    }
+}
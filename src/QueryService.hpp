@@ -0,0 +1,123 @@
+//  QueryService.hpp
+//  delta_xcode
+//
+//  Asynchronous interpolation requests from many threads against one shared Mesh
+//
+
+#ifndef query_service_h
+#define query_service_h
+
+#include "MeshReplicas.hpp"
+#include <atomic>
+#include <condition_variable>
+#include <future>
+#include <mutex>
+
+/**
+ *\brief Batching and latency targets for a QueryService
+ */
+struct QueryConfig
+{
+    size_t max_batch_;       ///< a worker takes at most this many requests at a time
+    double max_latency_;     ///< seconds a request may wait for its batch to fill up
+    unsigned int nworkers_;  ///< number of worker threads; 0 uses all hardware threads
+    bool numa_replicas_;     ///< copy the mesh onto every NUMA node and pin workers round-robin
+
+    inline QueryConfig(): max_batch_(256), max_latency_(1e-4), nworkers_(0), numa_replicas_(false) {}
+};
+
+/**
+ *\brief In-process interpolation service over a shared Mesh
+ *\details Producer threads submit query points and get a future or a callback back. Submitting is
+ *         lock-free: requests go onto an intrusive multi-producer queue. Worker threads wake up
+ *         when a batch worth of requests is waiting or the latency target runs out, take up to
+ *         max_batch_ requests, sort them along a Morton curve and interpolate them in that order,
+ *         starting each search from the previous result. Only one worker pops from the queue at a
+ *         time; the batches themselves are processed concurrently.
+ *
+ *         With numa_replicas_ set, the mesh is copied onto every NUMA node (see MeshReplicas) and
+ *         worker k is pinned to node k modulo the number of nodes, where it reads the local copy.
+ *\note The mesh is only read. Like Mesh::interp, query points have to be inside the domain.
+ */
+class QueryService
+{
+public:
+    /**
+     *\brief Starts the worker threads
+     *\param mesh   Mesh to interpolate on; has to outlive the service
+     *\param config Batching and latency targets
+     */
+    QueryService(Mesh& mesh, QueryConfig config = QueryConfig());
+
+    /**
+     *\brief Answers everything still queued, then stops the workers
+     */
+    ~QueryService();
+
+    /**
+     *\brief Queues one interpolation
+     *\return Future that receives the interpolated value
+     */
+    std::future<double> submit(MeshPoint p);
+
+    /**
+     *\brief Queues one interpolation; callback is called on a worker thread with the value
+     */
+    void submit(MeshPoint p, std::function<void(double)> callback);
+
+    /**
+     *\brief Number of requests answered so far and number of batches they came in
+     */
+    size_t answered();
+    size_t batches();
+
+private:
+    struct Request
+    {
+        MeshPoint p_;
+        std::promise<double> promise_;
+        std::function<void(double)> callback_;
+        std::atomic<Request*> next_;
+    };
+
+    /**
+     *\brief Links r onto the queue; safe to call from any number of threads
+     */
+    void enqueue(Request* r);
+
+    /**
+     *\brief Enqueues a request and wakes a worker if a full batch is waiting
+     */
+    void push(Request* r);
+
+    /**
+     *\brief Pops the oldest request; only one thread may call this at a time
+     *\return nullptr if the queue is empty (or a producer is half way through a push)
+     */
+    Request* pop();
+
+    /**
+     *\brief Loop run by worker k
+     */
+    void work(unsigned int k);
+
+    Mesh& mesh_;
+    QueryConfig config_;
+    MeshReplicas* replicas_;         // numa_replicas_ only
+
+    // intrusive MPSC queue (Vyukov): producers swap head_, the consumer follows tail_
+    std::atomic<Request*> head_;
+    Request* tail_;
+    Request stub_;
+    std::atomic_flag consuming_;     // held by the worker currently popping
+
+    std::atomic<size_t> pending_;
+    std::atomic<size_t> answered_;
+    std::atomic<size_t> batches_;
+    std::atomic<bool> stop_;
+    std::mutex sleep_mutex_;
+    std::condition_variable wake_;
+    std::vector<std::thread> workers_;
+};
+
+#endif /* query_service_h */
@@ -0,0 +1,290 @@
+//  ShardedMesh.cpp
+//  delta_xcode
+//
+
+#include "ShardedMesh.hpp"
+#include <algorithm>
+#include <limits>
+#include <stdint.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+// read/write the whole buffer; pipes may move less than asked at a time
+static bool readAll(int fd, void* buf, size_t bytes)
+{
+    char* p = static_cast<char*>(buf);
+    while (bytes > 0){
+        ssize_t got = read(fd, p, bytes);
+        if (got <= 0) return false;
+        p += got;
+        bytes -= got;
+    }
+    return true;
+}
+
+static bool writeAll(int fd, const void* buf, size_t bytes)
+{
+    const char* p = static_cast<const char*>(buf);
+    while (bytes > 0){
+        ssize_t put = write(fd, p, bytes);
+        if (put <= 0) return false;
+        p += put;
+        bytes -= put;
+    }
+    return true;
+}
+
+ShardedMesh::ShardedMesh(VecDoub& coords, VecDoub& val, size_t nshards, double halo)
+    :local_(false), served_(false)
+{
+    if (val.size() != coords.size() /2){
+        try {
+            throw ExitException(1);
+        } catch (ExitException& e) {
+            std::cerr << "Found " << val.size() << " values for ";
+            std::cerr << coords.size() /2 << " pairs of coordinates." << std::endl;
+            std::cout << e.what() << std::endl;
+        }
+    }
+    if (nshards == 0) nshards = 1;
+    std::vector<size_t> ids(val.size());
+    for (size_t i = 0; i < ids.size(); i++){
+        ids[i] = i;
+    }
+    double inf = std::numeric_limits<double>::infinity();
+    bisect(coords, ids, 0, ids.size(), nshards, -inf, inf, -inf, inf);
+
+    // every shard takes the points within halo of its box
+    for (size_t k = 0; k < shards_.size(); k++){
+        Shard& s = shards_[k];
+        for (size_t i = 0; i < val.size(); i++){
+            double x = coords[2 * i];
+            double y = coords[2 * i + 1];
+            if (x >= s.x_lo_ - halo && x <= s.x_hi_ + halo && y >= s.y_lo_ - halo && y <= s.y_hi_ + halo){
+                s.coords_.push_back(x);
+                s.coords_.push_back(y);
+                s.val_.push_back(val[i]);
+            }
+        }
+    }
+}
+
+ShardedMesh::~ShardedMesh()
+{
+    for (size_t k = 0; k < shards_.size(); k++){
+        Shard& s = shards_[k];
+        delete s.mesh_;
+        if (served_){
+            uint64_t stop = 0; // an empty batch tells the shard process to quit
+            writeAll(s.to_fd_, &stop, sizeof(stop));
+            close(s.to_fd_);
+            close(s.from_fd_);
+            waitpid(s.pid_, NULL, 0);
+        }
+    }
+}
+
+void ShardedMesh::bisect(VecDoub& coords, std::vector<size_t>& ids, size_t begin, size_t end, size_t n,
+                         double x_lo, double x_hi, double y_lo, double y_hi)
+{
+    if (n == 1 || end - begin < 2){
+        Shard s;
+        s.x_lo_ = x_lo;
+        s.x_hi_ = x_hi;
+        s.y_lo_ = y_lo;
+        s.y_hi_ = y_hi;
+        s.mesh_ = NULL;
+        s.last_ = 0;
+        s.pid_ = -1;
+        s.to_fd_ = -1;
+        s.from_fd_ = -1;
+        shards_.push_back(s);
+        return;
+    }
+    // cut across the longer side of the points' extent, at the median
+    double px_lo = std::numeric_limits<double>::max(), px_hi = -px_lo;
+    double py_lo = px_lo, py_hi = -px_lo;
+    for (size_t k = begin; k < end; k++){
+        px_lo = std::min(px_lo, coords[2 * ids[k]]);
+        px_hi = std::max(px_hi, coords[2 * ids[k]]);
+        py_lo = std::min(py_lo, coords[2 * ids[k] + 1]);
+        py_hi = std::max(py_hi, coords[2 * ids[k] + 1]);
+    }
+    int axis = (px_hi - px_lo >= py_hi - py_lo) ? 0 : 1;
+    size_t n_left = n / 2;
+    size_t mid = begin + (end - begin) * n_left / n;
+    std::nth_element(ids.begin() + begin, ids.begin() + mid, ids.begin() + end,
+                     [&coords, axis](size_t a, size_t b){
+                         return coords[2 * a + axis] < coords[2 * b + axis];
+                     });
+    double cut = coords[2 * ids[mid] + axis];
+    if (axis == 0){
+        bisect(coords, ids, begin, mid, n_left, x_lo, cut, y_lo, y_hi);
+        bisect(coords, ids, mid, end, n - n_left, cut, x_hi, y_lo, y_hi);
+    } else {
+        bisect(coords, ids, begin, mid, n_left, x_lo, x_hi, y_lo, cut);
+        bisect(coords, ids, mid, end, n - n_left, x_lo, x_hi, cut, y_hi);
+    }
+}
+
+void ShardedMesh::buildLocal()
+{
+    if (local_ || served_) return;
+    for (size_t k = 0; k < shards_.size(); k++){
+        shards_[k].mesh_ = new Mesh(shards_[k].coords_, shards_[k].val_);
+    }
+    local_ = true;
+}
+
+void ShardedMesh::serve()
+{
+    if (local_ || served_) return;
+    for (size_t k = 0; k < shards_.size(); k++){
+        Shard& s = shards_[k];
+        int to_child[2], from_child[2];
+        pid_t pid(-1);
+        try {
+            if (pipe(to_child) != 0 || pipe(from_child) != 0) throw ExitException(8);
+            pid = fork();
+            if (pid < 0) throw ExitException(8);
+        } catch (ExitException& e) {
+            e.what();
+        }
+        if (pid == 0){
+            // shard process: drop the parent's ends, including those of the earlier shards
+            close(to_child[1]);
+            close(from_child[0]);
+            for (size_t j = 0; j < k; j++){
+                close(shards_[j].to_fd_);
+                close(shards_[j].from_fd_);
+            }
+            shardMain(s, to_child[0], from_child[1]);
+            _exit(0);
+        }
+        close(to_child[0]);
+        close(from_child[1]);
+        s.pid_ = pid;
+        s.to_fd_ = to_child[1];
+        s.from_fd_ = from_child[0];
+        // the shard process has its own copy of the points now
+        VecDoub().swap(s.coords_);
+        VecDoub().swap(s.val_);
+    }
+    served_ = true;
+}
+
+void ShardedMesh::shardMain(Shard& shard, int in_fd, int out_fd)
+{
+    Mesh mesh(shard.coords_, shard.val_);
+    VecDoub().swap(shard.coords_);
+    VecDoub().swap(shard.val_);
+    VecDoub xy, out;
+    size_t t = 0;
+    while (true){
+        uint64_t count;
+        if (!readAll(in_fd, &count, sizeof(count)) || count == 0) break;
+        xy.resize(2 * count);
+        out.resize(count);
+        if (!readAll(in_fd, &xy[0], xy.size() * sizeof(double))) break;
+        for (size_t i = 0; i < count; i++){
+            MeshPoint p(xy[2 * i], xy[2 * i + 1]);
+            t = mesh.locate(p, t);
+            out[i] = mesh.interpInTriag(p, t);
+        }
+        if (!writeAll(out_fd, &out[0], out.size() * sizeof(double))) break;
+    }
+    close(in_fd);
+    close(out_fd);
+}
+
+size_t ShardedMesh::numShards()
+{
+    return shards_.size();
+}
+
+size_t ShardedMesh::shardSize(size_t k)
+{
+    if (served_) return 0; // the points live in the shard process
+    return shards_[k].val_.size();
+}
+
+size_t ShardedMesh::owner(MeshPoint p)
+{
+    for (size_t k = 0; k < shards_.size(); k++){
+        Shard& s = shards_[k];
+        if (p.x_ >= s.x_lo_ && p.x_ < s.x_hi_ && p.y_ >= s.y_lo_ && p.y_ < s.y_hi_) return k;
+    }
+    return 0; // NaN coordinates; let the search report it
+}
+
+double ShardedMesh::interp(MeshPoint p)
+{
+    std::vector<MeshPoint> points(1, p);
+    return interp(points)[0];
+}
+
+VecDoub ShardedMesh::interp(std::vector<MeshPoint>& points)
+{
+    try {
+        if (!local_ && !served_) throw ExitException(7);
+    } catch (ExitException& e) {
+        e.what();
+    }
+    VecDoub out(points.size());
+    std::vector<std::vector<size_t> > groups(shards_.size());
+    for (size_t i = 0; i < points.size(); i++){
+        groups[owner(points[i])].push_back(i);
+    }
+    if (local_){
+        for (size_t k = 0; k < shards_.size(); k++){
+            Shard& s = shards_[k];
+            for (size_t j = 0; j < groups[k].size(); j++){
+                MeshPoint& p = points[groups[k][j]];
+                s.last_ = s.mesh_->locate(p, s.last_);
+                out[groups[k][j]] = s.mesh_->interpInTriag(p, s.last_);
+            }
+        }
+        return out;
+    }
+    // hand out every group first so the shard processes run concurrently
+    for (size_t k = 0; k < shards_.size(); k++){
+        if (!groups[k].empty()) sendBatch(k, points, groups[k]);
+    }
+    for (size_t k = 0; k < shards_.size(); k++){
+        if (!groups[k].empty()) receiveBatch(k, groups[k], out);
+    }
+    return out;
+}
+
+void ShardedMesh::sendBatch(size_t k, std::vector<MeshPoint>& points, std::vector<size_t>& which)
+{
+    uint64_t count = which.size();
+    VecDoub xy(2 * which.size());
+    for (size_t j = 0; j < which.size(); j++){
+        xy[2 * j]     = points[which[j]].x_;
+        xy[2 * j + 1] = points[which[j]].y_;
+    }
+    try {
+        if (!writeAll(shards_[k].to_fd_, &count, sizeof(count)) ||
+            !writeAll(shards_[k].to_fd_, &xy[0], xy.size() * sizeof(double))){
+            throw ExitException(8);
+        }
+    } catch (ExitException& e) {
+        e.what();
+    }
+}
+
+void ShardedMesh::receiveBatch(size_t k, std::vector<size_t>& which, VecDoub& out)
+{
+    VecDoub values(which.size());
+    try {
+        if (!readAll(shards_[k].from_fd_, &values[0], values.size() * sizeof(double))){
+            throw ExitException(8);
+        }
+    } catch (ExitException& e) {
+        e.what();
+    }
+    for (size_t j = 0; j < which.size(); j++){
+        out[which[j]] = values[j];
+    }
+}
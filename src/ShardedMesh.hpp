@@ -0,0 +1,119 @@
+//  ShardedMesh.hpp
+//  delta_xcode
+//
+//  A point set split into spatial shards, each triangulated and queried on its own
+//
+
+#ifndef sharded_mesh_h
+#define sharded_mesh_h
+
+#include "Mesh.hpp"
+#include <sys/types.h>
+
+/**
+ *\brief Domain-decomposed interpolation over several Meshes
+ *\details The points are split by recursive coordinate bisection: the box is cut at the median
+ *         along its longer side until there are nshards boxes. Each shard owns the points in its
+ *         box and is triangulated together with a halo, the points within halo of the box, so
+ *         triangles near the cut look like those of the full triangulation. A query goes to the
+ *         shard whose box contains it.
+ *
+ *         Shards are either built in this process (buildLocal) or served by one child process each
+ *         (serve), which builds its Mesh after the fork and answers batches over a pair of pipes.
+ *         With serve, the parent only keeps the shard boxes.
+ *\note The halo should be a few point spacings wide; a query has to fall inside the triangulation
+ *      of its shard. Call serve before starting other threads: it forks.
+ */
+class ShardedMesh
+{
+public:
+    /**
+     *\brief Partitions the points; no triangulation is done yet
+     *\param coords  Coordinates {x1, y1, x2, y2, ...}, as for Mesh
+     *\param val     Function values on the points
+     *\param nshards Number of shards
+     *\param halo    Width of the layer of neighboring points added around each shard
+     */
+    ShardedMesh(VecDoub& coords, VecDoub& val, size_t nshards, double halo);
+
+    /**
+     *\brief Stops the shard processes, if any, and frees the shard meshes
+     */
+    ~ShardedMesh();
+
+    /**
+     *\brief Builds every shard's Mesh in this process
+     */
+    void buildLocal();
+
+    /**
+     *\brief Forks one process per shard, which builds the shard's Mesh and answers queries over pipes
+     */
+    void serve();
+
+    /**
+     *\brief Number of shards
+     */
+    size_t numShards();
+
+    /**
+     *\brief Number of points in shard k, halo included
+     */
+    size_t shardSize(size_t k);
+
+    /**
+     *\brief Index of the shard whose box contains p
+     */
+    size_t owner(MeshPoint p);
+
+    /**
+     *\brief Linear interpolation at p on the owning shard
+     */
+    double interp(MeshPoint p);
+
+    /**
+     *\brief Linear interpolation at many points
+     *\details Points are grouped by owner. With serve, every shard gets its whole group before any
+     *         answer is read, so the shard processes work on their groups at the same time.
+     */
+    VecDoub interp(std::vector<MeshPoint>& points);
+
+private:
+    ShardedMesh(const ShardedMesh&);
+    ShardedMesh& operator=(const ShardedMesh&);
+
+    struct Shard
+    {
+        double x_lo_, x_hi_, y_lo_, y_hi_; // owned box; open towards infinity on the outside
+        VecDoub coords_;                   // owned points plus halo
+        VecDoub val_;
+        Mesh* mesh_;                       // buildLocal only
+        size_t last_;                      // last triangle found, to start the next search from
+        pid_t pid_;                        // serve only
+        int to_fd_;                        // requests to the shard process
+        int from_fd_;                      // answers from the shard process
+    };
+
+    /**
+     *\brief Splits ids[begin, end) into n shards inside the given box
+     */
+    void bisect(VecDoub& coords, std::vector<size_t>& ids, size_t begin, size_t end, size_t n,
+                double x_lo, double x_hi, double y_lo, double y_hi);
+
+    /**
+     *\brief Loop run by a shard process: read a batch, interpolate, write the answers
+     */
+    static void shardMain(Shard& shard, int in_fd, int out_fd);
+
+    /**
+     *\brief Interpolates the points with the given positions on shard k; fills those positions of out
+     */
+    void sendBatch(size_t k, std::vector<MeshPoint>& points, std::vector<size_t>& which);
+    void receiveBatch(size_t k, std::vector<size_t>& which, VecDoub& out);
+
+    std::vector<Shard> shards_;
+    bool local_;
+    bool served_;
+};
+
+#endif /* sharded_mesh_h */
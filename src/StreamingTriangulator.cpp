@@ -0,0 +1,288 @@
+//  StreamingTriangulator.cpp
+//  delta_xcode
+//
+
+#include "StreamingTriangulator.hpp"
+#include <algorithm>
+#include <limits>
+#include <unordered_set>
+#include <unistd.h>
+
+static const char* TEMP_SUFFIX[4] = {".xy", ".val", ".tri", ".half"};
+
+StreamingTriangulator::StreamingTriangulator()
+    :xy_(NULL), val_(NULL), tri_(NULL), half_(NULL), ok_(false), npoints_(0), ntriag_(0),
+     frontier_(-std::numeric_limits<double>::infinity()), peak_active_(0), d_(NULL)
+{
+    // nothing else to do
+}
+
+StreamingTriangulator::~StreamingTriangulator()
+{
+    closeFiles();
+    delete d_;
+}
+
+bool StreamingTriangulator::open(const char* fname)
+{
+    closeFiles();
+    fname_ = fname;
+    FILE** files[4] = {&xy_, &val_, &tri_, &half_};
+    ok_ = true;
+    for (int k = 0; k < 4; k++){
+        *files[k] = fopen((fname_ + TEMP_SUFFIX[k]).c_str(), "wb");
+        ok_ = ok_ && *files[k] != NULL;
+    }
+    if (!ok_) closeFiles();
+    return ok_;
+}
+
+void StreamingTriangulator::closeFiles()
+{
+    FILE** files[4] = {&xy_, &val_, &tri_, &half_};
+    for (int k = 0; k < 4; k++){
+        if (*files[k] == NULL) continue;
+        fclose(*files[k]);
+        *files[k] = NULL;
+        remove((fname_ + TEMP_SUFFIX[k]).c_str());
+    }
+}
+
+size_t StreamingTriangulator::size()
+{
+    return npoints_;
+}
+
+size_t StreamingTriangulator::numTriag()
+{
+    return ntriag_;
+}
+
+size_t StreamingTriangulator::activeSize()
+{
+    return ids_.size();
+}
+
+size_t StreamingTriangulator::peakActiveSize()
+{
+    return peak_active_;
+}
+
+void StreamingTriangulator::addChunk(VecDoub& coords, VecDoub& val)
+{
+    TraceSpan span("StreamingTriangulator::addChunk");
+    size_t m = coords.size() / 2;
+    try {
+        if (val.size() != m){
+            std::cerr << "Found " << val.size() << " values for ";
+            std::cerr << m << " pairs of coordinates." << std::endl;
+            throw ExitException(1);
+        }
+        for (size_t i = 0; i < m; i++){
+            if (coords[2 * i] < frontier_) throw ExitException(11);
+        }
+    } catch (ExitException& e) {
+        e.what();
+    }
+    if (m == 0) return;
+    if (xy_ != NULL){
+        ok_ = ok_ && fwrite(&coords[0], sizeof(double), 2 * m, xy_) == 2 * m;
+        ok_ = ok_ && fwrite(&val[0], sizeof(double), m, val_) == m;
+    }
+    coords_.insert(coords_.end(), coords.begin(), coords.end());
+    for (size_t i = 0; i < m; i++){
+        ids_.push_back(npoints_ + i);
+        frontier_ = std::max(frontier_, coords[2 * i]);
+    }
+    npoints_ += m;
+    peak_active_ = std::max(peak_active_, ids_.size());
+    triangulateActive(false);
+    span.arg("active", double(ids_.size()));
+}
+
+void StreamingTriangulator::triangulateActive(bool last)
+{
+    size_t n = ids_.size();
+    if (n < 3) return;
+    try {
+        if (d_ == NULL){
+            d_ = new delaunator::Delaunator(coords_);
+        } else {
+            d_->update();
+        }
+    } catch (std::runtime_error&) {
+        return; // all collinear so far; wait for more points
+    }
+    const std::vector<size_t>& tri = d_->triangles;
+    const std::vector<size_t>& half = d_->halfedges;
+    size_t nt = tri.size() / 3;
+    auto key = [&](size_t e){
+        size_t next = (e % 3 == 2) ? e - 2 : e + 1;
+        return std::make_pair(uint64_t(ids_[tri[e]]), uint64_t(ids_[tri[next]]));
+    };
+
+    // triangles over the finished region: an edge of a written triangle, in the same direction,
+    // has the finished side on its left; flood from there without crossing such edges
+    enum {LIVE, COVERED, WRITTEN};
+    std::vector<char> state(nt, LIVE);
+    std::vector<size_t> stack;
+    for (size_t e = 0; e < tri.size(); e++){
+        if (state[e / 3] == LIVE && front_.count(key(e))){
+            state[e / 3] = COVERED;
+            stack.push_back(e / 3);
+        }
+    }
+    while (!stack.empty()){
+        size_t t = stack.back();
+        stack.pop_back();
+        for (size_t e = 3 * t; e < 3 * t + 3; e++){
+            size_t h = half[e];
+            if (h == delaunator::INVALID_INDEX || state[h / 3] != LIVE || front_.count(key(e))) continue;
+            state[h / 3] = COVERED;
+            stack.push_back(h / 3);
+        }
+    }
+
+    // finished: the circumcircle is left of every point still to come
+    for (size_t t = 0; t < nt; t++){
+        if (state[t] != LIVE) continue;
+        size_t a = tri[3 * t], b = tri[3 * t + 1], c = tri[3 * t + 2];
+        std::pair<double, double> cc = delaunator::circumcenter(coords_[2 * a], coords_[2 * a + 1],
+                                                                coords_[2 * b], coords_[2 * b + 1],
+                                                                coords_[2 * c], coords_[2 * c + 1]);
+        double r = std::sqrt(delaunator::dist(cc.first, cc.second, coords_[2 * a], coords_[2 * a + 1]));
+        if (last || cc.first + r < frontier_){
+            emit(ids_[a], ids_[b], ids_[c]);
+            state[t] = WRITTEN;
+        }
+    }
+
+    // keep the points of the triangles still open, and the ends of the boundary edges: triangles
+    // still to come may attach to a written hull edge from outside
+    std::unordered_set<uint64_t> boundary;
+    for (EdgeMap::iterator it = front_.begin(); it != front_.end(); ++it){
+        boundary.insert(it->first.first);
+        boundary.insert(it->first.second);
+    }
+    std::vector<char> keep(n, 0);
+    for (size_t t = 0; t < nt; t++){
+        if (state[t] != LIVE) continue;
+        keep[tri[3 * t]] = keep[tri[3 * t + 1]] = keep[tri[3 * t + 2]] = 1;
+    }
+    for (size_t i = 0; i < n; i++){
+        if (boundary.count(ids_[i])) keep[i] = 1;
+    }
+    size_t j = 0;
+    for (size_t i = 0; i < n; i++){
+        if (!keep[i]) continue;
+        coords_[2 * j] = coords_[2 * i];
+        coords_[2 * j + 1] = coords_[2 * i + 1];
+        ids_[j++] = ids_[i];
+    }
+    coords_.resize(2 * j);
+    ids_.resize(j);
+}
+
+void StreamingTriangulator::emit(uint64_t a, uint64_t b, uint64_t c)
+{
+    uint64_t v[3] = {a, b, c};
+    uint64_t half[3];
+    for (int k = 0; k < 3; k++){
+        uint64_t h = 3 * ntriag_ + k;
+        EdgeMap::iterator it = front_.find(std::make_pair(v[(k + 1) % 3], v[k]));
+        if (it != front_.end()){
+            // the neighbor is already on disk; its half edge gets fixed up later
+            half[k] = it->second;
+            patches_.push_back(std::make_pair(it->second, h));
+            front_.erase(it);
+        } else {
+            half[k] = uint64_t(delaunator::INVALID_INDEX);
+            front_[std::make_pair(v[k], v[(k + 1) % 3])] = h;
+        }
+    }
+    if (tri_ != NULL){
+        ok_ = ok_ && fwrite(v, sizeof(uint64_t), 3, tri_) == 3;
+        ok_ = ok_ && fwrite(half, sizeof(uint64_t), 3, half_) == 3;
+    }
+    ntriag_++;
+    if (patches_.size() >= (1 << 20)) flushPatches();
+}
+
+void StreamingTriangulator::flushPatches()
+{
+    if (half_ == NULL || patches_.empty()){
+        patches_.clear();
+        return;
+    }
+    // in file order, so the writes sweep through the file once
+    std::sort(patches_.begin(), patches_.end());
+    ok_ = ok_ && fflush(half_) == 0;
+    int fd = fileno(half_);
+    for (size_t k = 0; ok_ && k < patches_.size(); k++){
+        uint64_t h = patches_[k].second;
+        ok_ = pwrite(fd, &h, sizeof(h), off_t(patches_[k].first * sizeof(h))) == sizeof(h);
+    }
+    patches_.clear();
+}
+
+bool StreamingTriangulator::finish()
+{
+    TraceSpan span("StreamingTriangulator::finish");
+    triangulateActive(true);
+    flushPatches();
+    coords_.clear();
+    ids_.clear();
+    front_.clear();
+    if (xy_ == NULL) return false;
+
+    // header, then the temporary files one after the other
+    FILE* out = fopen(fname_.c_str(), "wb");
+    bool ok = ok_ && out != NULL;
+    uint32_t version = 1;
+    uint64_t header[2] = {npoints_, ntriag_};
+    ok = ok && fwrite("DMSH", 1, 4, out) == 4;
+    ok = ok && fwrite(&version, sizeof(version), 1, out) == 1;
+    ok = ok && fwrite(header, sizeof(uint64_t), 2, out) == 2;
+    FILE* files[4] = {xy_, val_, tri_, half_};
+    std::vector<char> buffer(1 << 20);
+    for (int k = 0; k < 4 && ok; k++){
+        ok = fflush(files[k]) == 0;
+        FILE* in = fopen((fname_ + TEMP_SUFFIX[k]).c_str(), "rb");
+        ok = ok && in != NULL;
+        size_t got;
+        while (ok && (got = fread(&buffer[0], 1, buffer.size(), in)) > 0){
+            ok = fwrite(&buffer[0], 1, got, out) == got;
+        }
+        if (in != NULL) fclose(in);
+    }
+    if (out != NULL) ok = (fclose(out) == 0) && ok;
+    closeFiles();
+    return ok;
+}
+
+bool StreamingTriangulator::triangulateFile(const char* points_fname, const char* mesh_fname, size_t chunk)
+{
+    FILE* in = fopen(points_fname, "rb");
+    if (in == NULL) return false;
+    StreamingTriangulator stream;
+    if (!stream.open(mesh_fname)){
+        fclose(in);
+        return false;
+    }
+    chunk = std::max(chunk, size_t(1));
+    VecDoub xyv(3 * chunk), coords, val;
+    size_t got;
+    while ((got = fread(&xyv[0], 3 * sizeof(double), chunk, in)) > 0){
+        coords.resize(2 * got);
+        val.resize(got);
+        for (size_t i = 0; i < got; i++){
+            coords[2 * i] = xyv[3 * i];
+            coords[2 * i + 1] = xyv[3 * i + 1];
+            val[i] = xyv[3 * i + 2];
+        }
+        stream.addChunk(coords, val);
+    }
+    bool ok = !ferror(in);
+    fclose(in);
+    return stream.finish() && ok;
+}
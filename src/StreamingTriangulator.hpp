@@ -0,0 +1,126 @@
+//  StreamingTriangulator.hpp
+//  delta_xcode
+//
+//  Delaunay triangulation of point sets too large for memory, streamed to a file in x order
+//
+
+#ifndef streaming_triangulator_h
+#define streaming_triangulator_h
+
+#include "Mesh.hpp"
+#include <stdint.h>
+#include <unordered_map>
+
+/**
+ *\brief Triangulates points that arrive in chunks sorted along x, writing finished triangles to disk
+ *\details Every chunk is added to the active points and the active points are triangulated again
+ *          (reusing the buffers of the last build, see delaunator::Delaunator::update). A triangle
+ *          whose circumcircle lies left of the largest x seen so far can't be changed by any point
+ *          still to come, so it is written out and forgotten; so are the points it no longer needs.
+ *          What stays in memory is the band of points near the front plus the edges along the
+ *          boundary of the finished region, not the whole point set.
+ *
+ *          Triangles written in an earlier pass are recognized in the next one by that boundary:
+ *          the active triangulation covers them again with triangles of its own, which are found by
+ *          a flood fill from the boundary edges and skipped.
+ *
+ *          The result is the file read by MappedMesh: the same triangles as a Mesh of all the
+ *          points would have, with half edges, in the order they were finished.
+ *\note The points should be in general position; for cocircular points (exact grids) passes may
+ *      choose different diagonals and the pieces need not fit. Jitter grids first.
+ */
+class StreamingTriangulator
+{
+public:
+    StreamingTriangulator();
+
+    ~StreamingTriangulator();
+
+    /**
+     *\brief Starts a new mesh file; temporary files fname.xy, .val, .tri and .half sit next to it
+     *\return false if a file can't be created
+     */
+    bool open(const char* fname);
+
+    /**
+     *\brief Adds a chunk of points
+     *\param coords {x1, y1, x2, y2, ...}; in any order within the chunk, but no x may be smaller
+     *              than an x of an earlier chunk
+     *\param val    Function values, half the size of coords
+     */
+    void addChunk(VecDoub& coords, VecDoub& val);
+
+    /**
+     *\brief Triangulates what is left and writes the mesh file
+     *\return false if writing failed at any point
+     */
+    bool finish();
+
+    /**
+     *\brief Points added, triangles written, points held in memory now and at most so far
+     */
+    size_t size();
+    size_t numTriag();
+    size_t activeSize();
+    size_t peakActiveSize();
+
+    /**
+     *\brief Streams a file of points into a mesh file
+     *\param points_fname Raw doubles {x, y, value} per point, sorted by x
+     *\param mesh_fname   Output, for MappedMesh
+     *\param chunk        Points read at a time
+     *\return false if a file can't be read or written
+     */
+    static bool triangulateFile(const char* points_fname, const char* mesh_fname, size_t chunk = 1 << 20);
+
+private:
+    StreamingTriangulator(const StreamingTriangulator&);
+    StreamingTriangulator& operator=(const StreamingTriangulator&);
+
+    struct EdgeHash
+    {
+        inline size_t operator()(const std::pair<uint64_t, uint64_t>& e) const
+        {
+            return size_t(e.first * 0x9E3779B97F4A7C15ull ^ e.second);
+        }
+    };
+    typedef std::unordered_map<std::pair<uint64_t, uint64_t>, uint64_t, EdgeHash> EdgeMap;
+
+    /**
+     *\brief Triangulates the active points, writes the finished triangles, drops unneeded points
+     *\param last Everything is finished; no more points come
+     */
+    void triangulateActive(bool last);
+
+    /**
+     *\brief Writes triangle (a, b, c) of global point indices and links its half edges
+     */
+    void emit(uint64_t a, uint64_t b, uint64_t c);
+
+    /**
+     *\brief Writes the opposite half edges found for triangles already on disk
+     */
+    void flushPatches();
+
+    void closeFiles();
+
+    std::string fname_;
+    FILE* xy_;
+    FILE* val_;
+    FILE* tri_;
+    FILE* half_;
+    bool ok_;
+
+    uint64_t npoints_;
+    uint64_t ntriag_;
+    double frontier_;               // largest x so far; points to come are not left of it
+    size_t peak_active_;
+
+    VecDoub coords_;                // active points
+    std::vector<uint64_t> ids_;     // their global indices
+    delaunator::Delaunator* d_;     // triangulation of coords_, rebuilt in place every pass
+    EdgeMap front_;                 // directed edge of a written triangle whose other side isn't -> its half edge
+    std::vector<std::pair<uint64_t, uint64_t> > patches_; // (half edge on disk, its opposite)
+};
+
+#endif /* streaming_triangulator_h */
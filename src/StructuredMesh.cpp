@@ -0,0 +1,174 @@
+//  StructuredMesh.cpp
+//  delta_xcode
+//
+
+#include "StructuredMesh.hpp"
+#include <algorithm>
+
+StructuredMesh::StructuredMesh(VecDoub& rr, VecDoub& zz, VecDoub& val)
+    :rr_(rr), zz_(zz), val_(val), uniform_r_(false), uniform_z_(false)
+{
+    setUp();
+}
+
+StructuredMesh::StructuredMesh(VecDoub& coords, VecDoub& val)
+    :val_(val), uniform_r_(false), uniform_z_(false)
+{
+    try {
+        if (!isRectilinear(coords, rr_, zz_)) throw ExitException(9);
+    } catch (ExitException& e) {
+        e.what();
+    }
+    setUp();
+}
+
+bool StructuredMesh::isRectilinear(VecDoub& coords, VecDoub& rr, VecDoub& zz)
+{
+    size_t n = coords.size() / 2;
+    if (n < 4 || coords.size() % 2 != 0) return false;
+    // the first column runs along y at fixed x
+    size_t nz = 1;
+    while (nz < n && coords[2 * nz] == coords[0]) nz++;
+    if (nz < 2 || n % nz != 0) return false;
+    size_t nr = n / nz;
+    if (nr < 2) return false;
+
+    VecDoub r(nr), z(nz);
+    for (size_t i = 0; i < nr; i++) r[i] = coords[2 * nz * i];
+    for (size_t j = 0; j < nz; j++) z[j] = coords[2 * j + 1];
+    for (size_t i = 0; i + 1 < nr; i++){
+        if (!(r[i] < r[i + 1])) return false;
+    }
+    for (size_t j = 0; j + 1 < nz; j++){
+        if (!(z[j] < z[j + 1])) return false;
+    }
+    for (size_t i = 0; i < nr; i++){
+        for (size_t j = 0; j < nz; j++){
+            size_t index = nz * i + j;
+            if (coords[2 * index] != r[i] || coords[2 * index + 1] != z[j]) return false;
+        }
+    }
+    rr.swap(r);
+    zz.swap(z);
+    return true;
+}
+
+void StructuredMesh::setUp()
+{
+    bool increasing = rr_.size() >= 2 && zz_.size() >= 2;
+    for (size_t i = 0; increasing && i + 1 < rr_.size(); i++){
+        increasing = rr_[i] < rr_[i + 1];
+    }
+    for (size_t j = 0; increasing && j + 1 < zz_.size(); j++){
+        increasing = zz_[j] < zz_[j + 1];
+    }
+    try {
+        if (!increasing) throw ExitException(9);
+        if (val_.size() != rr_.size() * zz_.size()) throw ExitException(1);
+    } catch (ExitException& e) {
+        e.what();
+    }
+
+    // uniform if every grid line is where linspace would put it, up to rounding
+    uniform_r_ = true;
+    double dr = (rr_.back() - rr_.front()) / (rr_.size() - 1);
+    for (size_t i = 0; uniform_r_ && i < rr_.size(); i++){
+        uniform_r_ = std::fabs(rr_[i] - (rr_.front() + i * dr)) <= 1e-12 * (rr_.back() - rr_.front());
+    }
+    uniform_z_ = true;
+    double dz = (zz_.back() - zz_.front()) / (zz_.size() - 1);
+    for (size_t j = 0; uniform_z_ && j < zz_.size(); j++){
+        uniform_z_ = std::fabs(zz_[j] - (zz_.front() + j * dz)) <= 1e-12 * (zz_.back() - zz_.front());
+    }
+}
+
+size_t StructuredMesh::size()
+{
+    return val_.size();
+}
+
+size_t StructuredMesh::numTriag()
+{
+    return 2 * (rr_.size() - 1) * (zz_.size() - 1);
+}
+
+std::vector<size_t> StructuredMesh::pointsOfTriag(size_t t)
+{
+    try {
+        if (t >= numTriag()) throw ExitException(4);
+    } catch (ExitException& e) {
+        e.what();
+    }
+    size_t nz = zz_.size();
+    size_t cell = t / 2;
+    size_t i = cell / (nz - 1);
+    size_t j = cell % (nz - 1);
+    size_t v00 = nz * i + j;
+    size_t v10 = v00 + nz;
+    std::vector<size_t> out(3);
+    out[0] = v00;
+    if (t % 2 == 0){
+        out[1] = v10;
+        out[2] = v10 + 1;
+    } else {
+        out[1] = v10 + 1;
+        out[2] = v00 + 1;
+    }
+    return out;
+}
+
+size_t StructuredMesh::interval(VecDoub& axis, bool uniform, double x)
+{
+    size_t last = axis.size() - 1;
+    if (!(x >= axis.front() && x <= axis.back())) return axis.size(); // also catches NaN
+    size_t k;
+    if (uniform){
+        double guess = (x - axis.front()) / (axis.back() - axis.front()) * last;
+        k = std::min(size_t(guess), last - 1);
+        // rounding may put x just across a grid line
+        if (k > 0 && x < axis[k]) k--;
+        else if (k + 1 < last && x > axis[k + 1]) k++;
+    } else {
+        k = std::upper_bound(axis.begin(), axis.end(), x) - axis.begin();
+        k = std::min(std::max(k, size_t(1)), last) - 1;
+    }
+    return k;
+}
+
+size_t StructuredMesh::locate(MeshPoint p, size_t /*init*/)
+{
+    size_t i = interval(rr_, uniform_r_, p.x_);
+    size_t j = interval(zz_, uniform_z_, p.y_);
+    try {
+        if (i == rr_.size() || j == zz_.size()) throw ExitException(3);
+    } catch (ExitException& e) {
+        e.what();
+    }
+    double u = (p.x_ - rr_[i]) / (rr_[i + 1] - rr_[i]);
+    double v = (p.y_ - zz_[j]) / (zz_[j + 1] - zz_[j]);
+    return 2 * (i * (zz_.size() - 1) + j) + ((v > u) ? 1 : 0);
+}
+
+double StructuredMesh::interpInTriag(MeshPoint p, size_t t)
+{
+    size_t nz = zz_.size();
+    size_t cell = t / 2;
+    size_t i = cell / (nz - 1);
+    size_t j = cell % (nz - 1);
+    double u = (p.x_ - rr_[i]) / (rr_[i + 1] - rr_[i]);
+    double v = (p.y_ - zz_[j]) / (zz_[j + 1] - zz_[j]);
+    size_t v00 = nz * i + j;
+    double f00 = val_[v00];
+    double f01 = val_[v00 + 1];
+    double f10 = val_[v00 + nz];
+    double f11 = val_[v00 + nz + 1];
+    if (t % 2 == 0){
+        return f00 + u * (f10 - f00) + v * (f11 - f10);
+    }
+    return f00 + u * (f11 - f01) + v * (f01 - f00);
+}
+
+double StructuredMesh::interp(MeshPoint p, size_t init)
+{
+    return interpInTriag(p, locate(p, init));
+}
@@ -0,0 +1,99 @@
+//  StructuredMesh.hpp
+//  delta_xcode
+//
+//  Interpolation on tensor-product grids without a triangulation
+//
+
+#ifndef structured_mesh_h
+#define structured_mesh_h
+
+#include "Mesh.hpp"
+
+/**
+ *\brief Mesh for points on a rectilinear grid, laid out like meshgrid in basic.cpp
+ *\details Vertex (i, j) is at (rr[i], zz[j]) and has index nz * i + j. Both axes have to be strictly
+ *          increasing; spacing may vary. Every cell is split along the diagonal from (i, j) to
+ *          (i+1, j+1) into two triangles, so interpolation is piecewise linear like on a Mesh.
+ *          There is nothing to build: a point is located by binary search on each axis, or by
+ *          arithmetic when an axis is uniformly spaced.
+ *
+ *          Triangle t = 2 * (i * (nz - 1) + j) is the lower right half of cell (i, j),
+ *          {(i, j), (i+1, j), (i+1, j+1)}; t + 1 is the upper left half, {(i, j), (i+1, j+1), (i, j+1)}.
+ */
+class StructuredMesh
+{
+public:
+    /**
+     *\brief Mesh over the grid spanned by two axes
+     *\param rr  Grid lines along x, strictly increasing
+     *\param zz  Grid lines along y, strictly increasing
+     *\param val Function values, rr.size() * zz.size() of them, index nz * i + j
+     */
+    StructuredMesh(VecDoub& rr, VecDoub& zz, VecDoub& val);
+
+    /**
+     *\brief Mesh over coordinates in meshgrid order, as they would be passed to Mesh
+     *\note Exits if the coordinates aren't a grid; check with isRectilinear first.
+     */
+    StructuredMesh(VecDoub& coords, VecDoub& val);
+
+    /**
+     *\brief Whether coords are a rectilinear grid in meshgrid order
+     *\param rr Receives the grid lines along x, if so
+     *\param zz Receives the grid lines along y, if so
+     */
+    static bool isRectilinear(VecDoub& coords, VecDoub& rr, VecDoub& zz);
+
+    /**
+     *\brief Get number of coordinate pairs
+     */
+    size_t size();
+
+    /**
+     *\brief Get the number of triangles, two per cell
+     */
+    size_t numTriag();
+
+    /**
+     *\brief Indices of the three vertices of triangle t, counterclockwise
+     */
+    std::vector<size_t> pointsOfTriag(size_t t);
+
+    /**
+     *\brief Triangle containing p
+     *\param init Unused; kept so calls written for Mesh::locate work unchanged
+     *\note Exits if p is outside the grid, like Mesh::locate.
+     */
+    size_t locate(MeshPoint p, size_t init = 0);
+
+    /**
+     *\brief Linear interpolation of the field at point p in triangle t
+     */
+    double interpInTriag(MeshPoint p, size_t t);
+
+    /**
+     *\brief Linear interpolation at p, same result as on a Mesh with the same cell split
+     *\param init Unused, see locate
+     */
+    double interp(MeshPoint p, size_t init = 0);
+
+private:
+    /**
+     *\brief Checks the axes and values, and finds out which axes are uniform
+     */
+    void setUp();
+
+    /**
+     *\brief Index k of the interval [axis[k], axis[k+1]] containing x
+     *\return axis.size() if x is outside the axis
+     */
+    size_t interval(VecDoub& axis, bool uniform, double x);
+
+    VecDoub rr_;
+    VecDoub zz_;
+    VecDoub val_;
+    bool uniform_r_;
+    bool uniform_z_;
+};
+
+#endif /* structured_mesh_h */
@@ -0,0 +1,184 @@
+//  Trace.hpp
+//  delta_xcode
+//
+//  Optional timing spans and counters, exported as Chrome trace-event JSON
+//
+
+#ifndef trace_h
+#define trace_h
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+/**
+ *\brief One recorded event: a span (phase 'X') or a set of counters (phase 'C')
+ */
+struct TraceEvent
+{
+    std::string name_;
+    char phase_;
+    double ts_;                                          ///< start, microseconds since the tracer was created
+    double dur_;                                         ///< microseconds; spans only
+    size_t tid_;
+    std::vector<std::pair<std::string, double> > args_;  ///< counters, or extra numbers shown with a span
+};
+
+/**
+ *\brief Process-wide event recorder
+ *\details Disabled by default. While disabled, spans and counters cost one atomic load and record
+ *          nothing, so the hooks stay compiled in. Recording takes a lock, so tracing is meant for
+ *          diagnosing a run, not for leaving on.
+ *\note The output of exportJson loads in chrome://tracing or Perfetto.
+ */
+class Tracer
+{
+public:
+    /**
+     *\brief The tracer all hooks in the library report to
+     */
+    static Tracer& global()
+    {
+        static Tracer tracer;
+        return tracer;
+    }
+
+    void enable(bool on = true) { enabled_.store(on, std::memory_order_relaxed); }
+
+    bool enabled() const { return enabled_.load(std::memory_order_relaxed); }
+
+    /**
+     *\brief Microseconds since the tracer was created
+     */
+    double now() const
+    {
+        return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - origin_).count();
+    }
+
+    /**
+     *\brief Records a span that started at ts and lasted dur microseconds
+     */
+    void span(const char* name, double ts, double dur,
+              const std::vector<std::pair<std::string, double> >& args)
+    {
+        if (!enabled()) return;
+        TraceEvent ev;
+        ev.name_ = name;
+        ev.phase_ = 'X';
+        ev.ts_ = ts;
+        ev.dur_ = dur;
+        ev.tid_ = threadId();
+        ev.args_ = args;
+        std::lock_guard<std::mutex> lock(mutex_);
+        events_.push_back(ev);
+    }
+
+    /**
+     *\brief Records the current values of a group of counters
+     */
+    void counter(const char* name, const std::vector<std::pair<std::string, double> >& values)
+    {
+        if (!enabled()) return;
+        TraceEvent ev;
+        ev.name_ = name;
+        ev.phase_ = 'C';
+        ev.ts_ = now();
+        ev.dur_ = 0;
+        ev.tid_ = threadId();
+        ev.args_ = values;
+        std::lock_guard<std::mutex> lock(mutex_);
+        events_.push_back(ev);
+    }
+
+    /**
+     *\brief Copy of everything recorded so far
+     */
+    std::vector<TraceEvent> events()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return events_;
+    }
+
+    void clear()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        events_.clear();
+    }
+
+    /**
+     *\brief Writes the recorded events as a Chrome trace-event JSON file
+     *\return false if the file can't be written
+     */
+    bool exportJson(const char* fname)
+    {
+        std::FILE* f = std::fopen(fname, "w");
+        if (f == NULL) return false;
+        std::lock_guard<std::mutex> lock(mutex_);
+        std::fprintf(f, "{\"traceEvents\":[");
+        for (size_t k = 0; k < events_.size(); k++){
+            const TraceEvent& ev = events_[k];
+            std::fprintf(f, "%s\n{\"name\":\"%s\",\"ph\":\"%c\",\"ts\":%.3f,", (k > 0) ? "," : "",
+                         ev.name_.c_str(), ev.phase_, ev.ts_);
+            if (ev.phase_ == 'X') std::fprintf(f, "\"dur\":%.3f,", ev.dur_);
+            std::fprintf(f, "\"pid\":1,\"tid\":%zu,\"args\":{", ev.tid_);
+            for (size_t j = 0; j < ev.args_.size(); j++){
+                std::fprintf(f, "%s\"%s\":%.17g", (j > 0) ? "," : "", ev.args_[j].first.c_str(), ev.args_[j].second);
+            }
+            std::fprintf(f, "}}");
+        }
+        std::fprintf(f, "\n],\"displayTimeUnit\":\"ms\"}\n");
+        return std::fclose(f) == 0;
+    }
+
+private:
+    Tracer(): enabled_(false), origin_(std::chrono::steady_clock::now()) {}
+
+    static size_t threadId()
+    {
+        return std::hash<std::thread::id>()(std::this_thread::get_id()) & 0xffffffff;
+    }
+
+    std::atomic<bool> enabled_;
+    std::chrono::steady_clock::time_point origin_;
+    std::mutex mutex_;
+    std::vector<TraceEvent> events_;
+};
+
+/**
+ *\brief Records a span from construction to destruction if tracing is enabled
+ */
+class TraceSpan
+{
+public:
+    explicit TraceSpan(const char* name)
+        :name_(name), on_(Tracer::global().enabled()), start_(on_ ? Tracer::global().now() : 0) {}
+
+    ~TraceSpan()
+    {
+        if (on_) Tracer::global().span(name_, start_, Tracer::global().now() - start_, args_);
+    }
+
+    /**
+     *\brief Attaches a number to the span, shown in the trace viewer
+     */
+    void arg(const char* key, double value)
+    {
+        if (on_) args_.push_back(std::make_pair(std::string(key), value));
+    }
+
+    bool on() const { return on_; }
+
+private:
+    const char* name_;
+    bool on_;
+    double start_;
+    std::vector<std::pair<std::string, double> > args_;
+};
+
+#endif /* trace_h */
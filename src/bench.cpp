@@ -0,0 +1,205 @@
+//  bench.cpp
+//  delta_xcode
+//
+//  Timings of the triangulation and of point location; run with ./bench
+//
+
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#include "Mesh.hpp"
+
+//-------------- inputs -----------------------------
+std::vector<double> linspace(double start, double end, int num)
+{
+    std::vector<double> out(num);
+    double d = (end - start) / (num - 1);
+    for(int i = 0; i<num; i++){
+        out[i] = start + i * d;
+    }
+    return out;
+}
+
+std::vector<double> meshgrid(std::vector<double>& rr, std::vector<double>& zz)
+{
+    int nr = rr.size();
+    int nz = zz.size();
+
+    std::vector<double> out(nr * nz * 2);
+    for(int i = 0; i < nr; i++){
+        for(int j = 0; j < nz; j++){
+            int index = (nz * i + j) * 2;
+            out[index]    = rr[i];
+            out[index +1] = zz[j];
+        }
+    }
+    return out;
+}
+
+// points on a thin annulus; nearly all of them end up on the hull at some point of the sweep
+std::vector<double> ring(int num)
+{
+    std::vector<double> out(2 * num);
+    for(int i = 0; i < num; i++){
+        double a = 2 * M_PI * i / num;
+        double r = 1 + 0.01 * ((i * 7919) % 13) / 13.0;
+        out[2 * i]     = r * std::cos(a);
+        out[2 * i + 1] = r * std::sin(a);
+    }
+    return out;
+}
+
+//-------------- timing -----------------------------
+double millisecondsSince(std::chrono::steady_clock::time_point t0)
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+}
+
+// best of a few runs
+void benchTriangulation(const char* name, std::vector<double>& coords)
+{
+    double best(0);
+    size_t ntriag(0);
+    for (int run = 0; run < 3; run++){
+        std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+        delaunator::Delaunator d(coords);
+        double ms = millisecondsSince(t0);
+        if (run == 0 || ms < best) best = ms;
+        ntriag = d.triangles.size() / 3;
+    }
+    size_t n = coords.size() / 2;
+    printf("%-8s %10zu points %10zu triangles %10.2f ms %8.1f ns/point\n",
+           name, n, ntriag, best, best * 1e6 / n);
+}
+
+// a cloud that moves a little every step: a new Mesh per step against Mesh::rebuild
+void benchRebuild(int num, int steps)
+{
+    std::mt19937 gen(1);
+    std::uniform_real_distribution<double> unit(0, 1), jitter(-1e-4, 1e-4);
+    std::vector<double> coords(2 * num), val(num, 0.0);
+    for (size_t i = 0; i < coords.size(); i++) coords[i] = unit(gen);
+    std::vector<double> start(coords);
+
+    std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+    for (int s = 0; s < steps; s++){
+        for (size_t i = 0; i < coords.size(); i++) coords[i] += jitter(gen);
+        Mesh mesh(coords, val);
+    }
+    double fresh = millisecondsSince(t0) / steps;
+
+    coords = start;
+    Mesh mesh(coords, val);
+    t0 = std::chrono::steady_clock::now();
+    for (int s = 0; s < steps; s++){
+        for (size_t i = 0; i < coords.size(); i++) coords[i] += jitter(gen);
+        mesh.rebuild(coords, val);
+    }
+    double reused = millisecondsSince(t0) / steps;
+    printf("moving   %10d points %10.2f ms new mesh %10.2f ms rebuild\n", num, fresh, reused);
+}
+
+void benchMove(int num, int steps)
+{
+    std::mt19937 gen(1);
+    std::uniform_real_distribution<double> unit(0, 1), jitter(-1e-4, 1e-4);
+    std::vector<double> coords(2 * num), val(num, 0.0);
+    for (size_t i = 0; i < coords.size(); i++) coords[i] = unit(gen);
+    // one point in a hundred drifts; the hull stays put
+    std::vector<size_t> ids;
+    for (int i = 0; i < num; i += 100){
+        double x = coords[2 * i], y = coords[2 * i + 1];
+        if (x > 0.01 && x < 0.99 && y > 0.01 && y < 0.99) ids.push_back(i);
+    }
+    Mesh mesh(coords, val);
+    Mesh moved(coords, val);
+    std::vector<double> xy(2 * ids.size());
+    double reused(0), kinetic(0);
+    int local(0);
+    for (int s = 0; s < steps; s++){
+        for (size_t k = 0; k < ids.size(); k++){
+            xy[2 * k] = coords[2 * ids[k]] += jitter(gen);
+            xy[2 * k + 1] = coords[2 * ids[k] + 1] += jitter(gen);
+        }
+        std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+        mesh.rebuild(coords, val);
+        reused += millisecondsSince(t0) / steps;
+        t0 = std::chrono::steady_clock::now();
+        local += moved.moveVertices(ids, xy);
+        kinetic += millisecondsSince(t0) / steps;
+    }
+    printf("moving 1%% of %7d points %10.2f ms rebuild %10.2f ms moveVertices (%d/%d by flips)\n",
+           num, reused, kinetic, local, steps);
+}
+
+// particles that moved a little since their last search, in no particular order: one walk at a
+// time against interleaved walks, on meshes that fit in the cache and ones that don't
+void benchBatchLocate(int num, int queries)
+{
+    std::mt19937 gen(1);
+    std::uniform_real_distribution<double> unit(0, 1), inner(0.01, 0.99);
+    std::vector<double> coords(2 * num), val(num, 0.0);
+    for (size_t i = 0; i < coords.size(); i++) coords[i] = unit(gen);
+    Mesh mesh(coords, val);
+    std::vector<MeshPoint> points(queries);
+    for (int q = 0; q < queries; q++){
+        points[q] = MeshPoint(inner(gen), inner(gen));
+    }
+    std::vector<size_t> start(queries, 0);
+    mesh.tryLocate(points, start);
+    double h = 3 / std::sqrt(double(num)); // a few triangles away
+    for (int q = 0; q < queries; q++){
+        points[q].x_ += h * (unit(gen) - 0.5);
+        points[q].y_ += h * (unit(gen) - 0.5);
+    }
+
+    std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+    for (int q = 0; q < queries; q++){
+        mesh.tryLocate(points[q], start[q]);
+    }
+    double single = millisecondsSince(t0);
+    double batch[2];
+    size_t lanes[2] = {1, 16};
+    for (int k = 0; k < 2; k++){
+        std::vector<size_t> triags(start);
+        t0 = std::chrono::steady_clock::now();
+        mesh.tryLocate(points, triags, lanes[k]);
+        batch[k] = millisecondsSince(t0);
+    }
+    printf("%8d points %6zu MB %10.2f ms tryLocate %10.2f ms 1 lane %10.2f ms 16 lanes\n",
+           num, mesh.memoryUsage().total_ >> 20, single, batch[0], batch[1]);
+}
+
+int main() {
+    printf("--- triangulation, meshgrid inputs\n");
+    int sizes[] = {100, 200, 400, 800, 1600};
+    for (int k = 0; k < 5; k++){
+        std::vector<double> rr = linspace(0, 1, sizes[k]);
+        std::vector<double> zz = linspace(-1, 1, sizes[k]);
+        std::vector<double> coords = meshgrid(rr, zz);
+        benchTriangulation("meshgrid", coords);
+    }
+    printf("--- triangulation, ring inputs\n");
+    int rings[] = {10000, 40000, 160000, 640000};
+    for (int k = 0; k < 4; k++){
+        std::vector<double> coords = ring(rings[k]);
+        benchTriangulation("ring", coords);
+    }
+    printf("--- rebuild per step, moving points\n");
+    int clouds[] = {10000, 100000, 1000000};
+    for (int k = 0; k < 3; k++){
+        benchRebuild(clouds[k], 5);
+    }
+    printf("--- a few points moving per step\n");
+    for (int k = 0; k < 3; k++){
+        benchMove(clouds[k], 5);
+    }
+    printf("--- locating 1M moved particles\n");
+    int meshes[] = {100000, 1000000, 4000000};
+    for (int k = 0; k < 3; k++){
+        benchBatchLocate(meshes[k], 1000000);
+    }
+    return 0;
+}
@@ -0,0 +1,298 @@
+//  check.cpp
+//  delta_xcode
+//
+//  Checks of the incremental and cached structures against what they stand in for; run with
+//  ./check, which exits with 1 if any check fails
+//
+
+#include <algorithm>
+#include <array>
+#include <cstdio>
+#include <random>
+#include <set>
+#include <vector>
+
+#include "CloughTocher.hpp"
+#include "MappedMesh.hpp"
+#include "Mesh.hpp"
+#include "StreamingTriangulator.hpp"
+
+//-------------- helpers -----------------------------
+int failures = 0;
+
+void expect(bool ok, const char* what)
+{
+    if (!ok){
+        printf("  FAILED: %s\n", what);
+        failures++;
+    }
+}
+
+// the triangles of a mesh as sorted vertex triples, whatever their numbering
+std::set<std::array<size_t, 3> > triangleSet(Mesh& mesh)
+{
+    std::set<std::array<size_t, 3> > out;
+    for (size_t t = 0; t < 3 * mesh.numTriag(); t += 3){
+        std::vector<size_t> p = mesh.pointsOfTriag(t);
+        std::array<size_t, 3> v = {{p[0] / 2, p[2] / 2, p[4] / 2}};
+        std::sort(v.begin(), v.end());
+        out.insert(v);
+    }
+    return out;
+}
+
+// the vertex index gives every vertex the neighbors it has in the triangles
+bool sameStars(Mesh& a, Mesh& b)
+{
+    for (size_t i = 0; i < a.size(); i++){
+        std::vector<size_t> na = a.neighborsOfVertex(i);
+        std::vector<size_t> nb = b.neighborsOfVertex(i);
+        if (std::set<size_t>(na.begin(), na.end()) != std::set<size_t>(nb.begin(), nb.end())) return false;
+    }
+    return true;
+}
+
+//-------------- checks ------------------------------
+// points drifting every step, against a new triangulation of the same points. Most steps keep
+// the hull pinned and move a tenth of the points, which flips have to repair; others move the
+// hull too, move every point or start from the compact layout
+void checkMoveVertices()
+{
+    printf("--- Mesh::moveVertices against a fresh triangulation\n");
+    std::mt19937 gen(5);
+    std::uniform_real_distribution<double> uniform(0, 1);
+    std::normal_distribution<double> normal(0, 1);
+    size_t n = 5000;
+    std::vector<double> coords(2 * n), val(n, 0);
+    for (size_t i = 0; i < 2 * n; i++){
+        coords[i] = uniform(gen);
+    }
+    Mesh mesh(coords, val);
+    mesh.buildVertexIndex();
+    double step = 0.05 / std::sqrt(double(n));
+    for (int it = 0; it < 30; it++){
+        if (it % 3 == 2) mesh.compact();
+        bool all = it % 5 == 4;
+        bool pinned = it % 7 != 6;
+        std::vector<size_t> ids;
+        std::vector<double> xy;
+        for (size_t i = 0; i < n; i++){
+            if (!all && uniform(gen) >= 0.1) continue;
+            bool inner = std::min(coords[2 * i], coords[2 * i + 1]) > 0.02
+                      && std::max(coords[2 * i], coords[2 * i + 1]) < 0.98;
+            if (pinned && !inner) continue;
+            ids.push_back(i);
+            coords[2 * i] += step * normal(gen);
+            coords[2 * i + 1] += step * normal(gen);
+            xy.push_back(coords[2 * i]);
+            xy.push_back(coords[2 * i + 1]);
+        }
+        bool local = mesh.moveVertices(ids, xy);
+        if (!all && pinned) expect(local, "a tenth of the points, hull pinned, repaired by flips");
+
+        std::vector<double> fresh_coords = coords, fresh_val = val;
+        Mesh fresh(fresh_coords, fresh_val);
+        fresh.buildVertexIndex();
+        expect(triangleSet(mesh) == triangleSet(fresh), "same triangles as a new triangulation");
+        expect(sameStars(mesh, fresh), "vertex index matches the triangles");
+    }
+}
+
+// points streamed in chunks along x, against a Mesh of all of them: the same triangles, and the
+// same values from walks over the mapped file
+void checkStreaming()
+{
+    printf("--- StreamingTriangulator against a Mesh of all the points\n");
+    std::mt19937 gen(11);
+    std::uniform_real_distribution<double> uniform(0, 1);
+    size_t n = 20000, chunk = 1000;
+    std::vector<std::array<double, 3> > points(n);
+    for (size_t i = 0; i < n; i++){
+        points[i][0] = 10 * uniform(gen);
+        points[i][1] = uniform(gen);
+        points[i][2] = std::sin(points[i][0]) * points[i][1];
+    }
+    std::sort(points.begin(), points.end());
+    std::vector<double> coords, val;
+    for (size_t i = 0; i < n; i++){
+        coords.push_back(points[i][0]);
+        coords.push_back(points[i][1]);
+        val.push_back(points[i][2]);
+    }
+
+    const char* fname = "check_stream.dmsh";
+    StreamingTriangulator stream;
+    bool ok = stream.open(fname);
+    for (size_t i = 0; ok && i < n; i += chunk){
+        size_t end = std::min(n, i + chunk);
+        std::vector<double> chunk_coords(coords.begin() + 2 * i, coords.begin() + 2 * end);
+        std::vector<double> chunk_val(val.begin() + i, val.begin() + end);
+        stream.addChunk(chunk_coords, chunk_val);
+    }
+    ok = ok && stream.finish();
+    expect(ok, "mesh file written");
+    expect(stream.peakActiveSize() < n / 2, "only a band of the points held in memory");
+
+    Mesh mesh(coords, val);
+    MappedMesh mapped;
+    expect(mapped.open(fname), "mesh file mapped");
+    std::set<std::array<size_t, 3> > streamed;
+    for (size_t t = 0; t < 3 * mapped.numTriag(); t += 3){
+        size_t v[3];
+        mapped.verticesOfTriag(t, v);
+        std::array<size_t, 3> a = {{v[0], v[1], v[2]}};
+        std::sort(a.begin(), a.end());
+        streamed.insert(a);
+    }
+    expect(mapped.numTriag() == mesh.numTriag() && streamed == triangleSet(mesh), "same triangles as the Mesh");
+
+    // walks from the first triangle cross the whole file through its half edges
+    bool same = mapped.numTriag() > 0;
+    for (int k = 0; same && k < 1000; k++){
+        MeshPoint p(0.1 + 9.8 * uniform(gen), 0.01 + 0.98 * uniform(gen));
+        size_t t = mapped.tryLocate(p, 0);
+        same = t != delaunator::INVALID_INDEX && std::fabs(mapped.interpInTriag(p, t) - mesh.interp(p, 0)) < 1e-12;
+    }
+    expect(same, "same values as the Mesh");
+    std::remove(fname);
+}
+
+// the Voronoi dual of random points in a square and in a disk: the cells tile the domain, each
+// holds its own point, and the thread count doesn't change them
+void checkVoronoi()
+{
+    printf("--- Mesh::voronoi against the triangulation\n");
+    std::mt19937 gen(5);
+    std::uniform_real_distribution<double> uniform(0, 1);
+    for (int shape = 0; shape < 2; shape++){
+        size_t n = 20000;
+        std::vector<double> coords(2 * n), val(n, 0);
+        for (size_t i = 0; i < n; i++){
+            double a = uniform(gen), b = uniform(gen);
+            if (shape == 1){
+                double r = std::sqrt(a);
+                a = r * std::cos(2 * M_PI * b);
+                b = r * std::sin(2 * M_PI * b);
+            }
+            coords[2 * i] = a;
+            coords[2 * i + 1] = b;
+        }
+        Mesh mesh(coords, val);
+        VoronoiDual& dual = mesh.voronoi(4);
+        double area(0), cx(0), cy(0);
+        bool inside = true;
+        for (size_t i = 0; i < n; i++){
+            area += dual.area_[i];
+            cx += dual.area_[i] * dual.centroid_[i].x_;
+            cy += dual.area_[i] * dual.centroid_[i].y_;
+            std::vector<MeshPoint> cell = dual.cell(i);
+            for (size_t k = 0; inside && k < cell.size(); k++){
+                const MeshPoint& a = cell[k];
+                const MeshPoint& b = cell[(k + 1) % cell.size()];
+                inside = (b.x_ - a.x_) * (coords[2 * i + 1] - a.y_) - (b.y_ - a.y_) * (coords[2 * i] - a.x_) > -1e-12;
+            }
+        }
+        // centroid of the domain, from the triangles
+        double tx(0), ty(0);
+        for (size_t t = 0; t < 3 * mesh.numTriag(); t += 3){
+            std::vector<MeshPoint> p = mesh.coordsOfTriag(t);
+            double a = std::fabs((p[1].x_ - p[0].x_) * (p[2].y_ - p[0].y_) - (p[2].x_ - p[0].x_) * (p[1].y_ - p[0].y_)) / 2;
+            tx += a * (p[0].x_ + p[1].x_ + p[2].x_) / 3;
+            ty += a * (p[0].y_ + p[1].y_ + p[2].y_) / 3;
+        }
+        double domain = mesh.area(1);
+        expect(std::fabs(area - domain) < 1e-9 * domain, "cell areas add up to Mesh::area");
+        expect(std::fabs(cx - tx) < 1e-9 && std::fabs(cy - ty) < 1e-9, "cell centroids add up to the domain's");
+        expect(inside, "every point inside its cell");
+
+        std::vector<double> coords1 = coords, val1 = val;
+        Mesh mesh1(coords1, val1);
+        VoronoiDual& dual1 = mesh1.voronoi(1);
+        expect(dual1.cell_points_.size() == dual.cell_points_.size() && dual1.area_ == dual.area_,
+               "same cells on one thread");
+    }
+}
+
+// Clough-Tocher on jittered grids and on random points: quadratics are reproduced to round-off,
+// smooth fields converge with h^3, and the coefficients don't depend on the thread count
+double quadratic(double x, double y)
+{
+    return 1 + 2 * x - 3 * y + x * x - 2 * x * y + 0.5 * y * y;
+}
+
+double smooth(double x, double y)
+{
+    return std::sin(3 * x) * std::cos(2 * y);
+}
+
+void checkCloughTocher()
+{
+    printf("--- CloughTocher against quadratic and smooth fields\n");
+    std::mt19937 gen(3);
+    std::uniform_real_distribution<double> uniform(0, 1);
+    double error[2] = {0, 0};
+    for (int level = 0; level < 2; level++){
+        int m = 40 << level;
+        std::vector<double> coords, val_quadratic, val_smooth;
+        for (int i = 0; i <= m; i++){
+            for (int j = 0; j <= m; j++){
+                double x = double(i) / m, y = double(j) / m;
+                if (i > 0 && i < m) x += (uniform(gen) - 0.5) * 0.3 / m;
+                if (j > 0 && j < m) y += (uniform(gen) - 0.5) * 0.3 / m;
+                coords.push_back(x);
+                coords.push_back(y);
+                val_quadratic.push_back(quadratic(x, y));
+                val_smooth.push_back(smooth(x, y));
+            }
+        }
+        std::vector<double> coords_smooth = coords;
+        Mesh mesh_quadratic(coords, val_quadratic), mesh_smooth(coords_smooth, val_smooth);
+        CloughTocher ct_quadratic(mesh_quadratic), ct_smooth(mesh_smooth, 1), ct_threads(mesh_smooth, 4);
+        double exact(0);
+        bool same = true;
+        size_t t(0);
+        for (int k = 0; k < 10000; k++){
+            MeshPoint p(0.001 + 0.998 * uniform(gen), 0.001 + 0.998 * uniform(gen));
+            exact = std::max(exact, std::fabs(ct_quadratic.interp(p, 0) - quadratic(p.x_, p.y_)));
+            t = mesh_smooth.locate(p, t);
+            double f = ct_smooth.interpInTriag(p, t);
+            error[level] = std::max(error[level], std::fabs(f - smooth(p.x_, p.y_)));
+            same = same && f == ct_threads.interpInTriag(p, t);
+        }
+        expect(exact < 1e-12, "quadratic reproduced on a jittered grid");
+        expect(same, "same values on one thread and on four");
+    }
+    expect(error[0] > 6 * error[1], "error falls with h^3 on a smooth field");
+
+    // scattered points; stars on the hull fit their gradients on two rings
+    size_t n = 2000;
+    std::vector<double> coords(2 * n), val(n);
+    for (size_t i = 0; i < n; i++){
+        coords[2 * i] = uniform(gen);
+        coords[2 * i + 1] = uniform(gen);
+        val[i] = quadratic(coords[2 * i], coords[2 * i + 1]);
+    }
+    Mesh mesh(coords, val);
+    CloughTocher ct(mesh);
+    double exact(0);
+    size_t t(0);
+    for (int k = 0; k < 10000; k++){
+        MeshPoint p(0.05 + 0.9 * uniform(gen), 0.05 + 0.9 * uniform(gen));
+        t = mesh.locate(p, t);
+        exact = std::max(exact, std::fabs(ct.interpInTriag(p, t) - quadratic(p.x_, p.y_)));
+    }
+    expect(exact < 1e-10, "quadratic reproduced on scattered points");
+}
+
+int main() {
+    checkMoveVertices();
+    checkStreaming();
+    checkVoronoi();
+    checkCloughTocher();
+    if (failures > 0){
+        printf("%d checks failed\n", failures);
+        return 1;
+    }
+    printf("all checks passed\n");
+    return 0;
+}
@@ -10,6 +10,8 @@
 #include <utility>
 #include <vector>
 
+#include "Trace.hpp"
+
 /**
  MIT License
 
@@ -200,16 +202,44 @@ public:
 
     Delaunator(std::vector<double> const& in_coords);
 
+    // copy of other's triangulation, bound to in_coords, which must hold the same points;
+    // without construction the buffers only needed while building are left out, as after trim()
+    Delaunator(Delaunator const& other, std::vector<double> const& in_coords, bool construction = true);
+
+    // triangulates coords again after the caller changed them in place; every buffer keeps its
+    // capacity, and the previous sort order is the starting point of the new sort
+    void update();
+
+    // restores the Delaunay property after the caller moved points in place without tangling the
+    // triangles: checks the half edges in edges (which is used up as the work stack), flips the
+    // illegal ones and checks the edges around every flip again. Each flip appends its two half
+    // edges to flipped. Returns false if it gave up after too many flips; call update() then
+    bool relegalize(std::vector<std::size_t>& edges, std::vector<std::size_t>& flipped);
+
     double get_hull_area();
 
+    // frees the buffers only needed while building; triangles and halfedges stay
+    void trim();
+
+    // bytes held by the construction-only buffers
+    std::size_t construction_bytes() const;
+
 private:
     std::vector<std::size_t> m_hash;
     double m_center_x;
     double m_center_y;
     std::size_t m_hash_size;
     std::vector<std::size_t> m_edge_stack;
+    std::vector<std::size_t> m_ids;
 
+    // build statistics, reported to Tracer::global() when it is enabled
+    bool m_tracing;
+    std::size_t m_flips;
+    double m_legalize_us;
+
+    void sort_ids();
     std::size_t legalize(std::size_t a);
+    void flip(std::size_t a, std::size_t b);
     std::size_t hash_key(double x, double y) const;
     std::size_t add_triangle(
         std::size_t i0,
@@ -233,15 +263,44 @@ inline Delaunator::Delaunator(std::vector<double> const& in_coords)
       m_center_x(),
       m_center_y(),
       m_hash_size(),
-      m_edge_stack() {
+      m_edge_stack(),
+      m_ids(),
+      m_tracing(false),
+      m_flips(0),
+      m_legalize_us(0) {
+    update();
+}
+
+inline Delaunator::Delaunator(Delaunator const& other, std::vector<double> const& in_coords, bool construction)
+    : coords(in_coords),
+      triangles(other.triangles),
+      halfedges(other.halfedges),
+      hull_prev(construction ? other.hull_prev : std::vector<std::size_t>()),
+      hull_next(construction ? other.hull_next : std::vector<std::size_t>()),
+      hull_tri(construction ? other.hull_tri : std::vector<std::size_t>()),
+      hull_start(other.hull_start),
+      m_hash(construction ? other.m_hash : std::vector<std::size_t>()),
+      m_center_x(other.m_center_x),
+      m_center_y(other.m_center_y),
+      m_hash_size(other.m_hash_size),
+      m_edge_stack(),
+      m_ids(construction ? other.m_ids : std::vector<std::size_t>()),
+      m_tracing(false),
+      m_flips(0),
+      m_legalize_us(0) {}
+
+inline void Delaunator::update() {
     std::size_t n = coords.size() >> 1;
+    Tracer& tracer = Tracer::global();
+    m_tracing = tracer.enabled();
+    m_flips = 0;
+    m_legalize_us = 0;
+    const double t_build = m_tracing ? tracer.now() : 0;
 
     double max_x = std::numeric_limits<double>::min();
     double max_y = std::numeric_limits<double>::min();
     double min_x = std::numeric_limits<double>::max();
     double min_y = std::numeric_limits<double>::max();
-    std::vector<std::size_t> ids;
-    ids.reserve(n);
 
     for (std::size_t i = 0; i < n; i++) {
         const double x = coords[2 * i];
@@ -251,8 +310,14 @@ inline Delaunator::Delaunator(std::vector<double> const& in_coords)
         if (y < min_y) min_y = y;
         if (x > max_x) max_x = x;
         if (y > max_y) max_y = y;
+    }
 
-        ids.push_back(i);
+    // keep the previous order of the points that are still there, then append the new ones
+    const std::size_t n_prev = m_ids.size();
+    m_ids.erase(std::remove_if(m_ids.begin(), m_ids.end(),
+                               [n](std::size_t i) { return i >= n; }), m_ids.end());
+    for (std::size_t i = n_prev; i < n; i++) {
+        m_ids.push_back(i);
     }
     const double cx = (min_x + max_x) / 2;
     const double cy = (min_y + max_y) / 2;
@@ -319,13 +384,21 @@ inline Delaunator::Delaunator(std::vector<double> const& in_coords)
 
     std::tie(m_center_x, m_center_y) = circumcenter(i0x, i0y, i1x, i1y, i2x, i2y);
 
+    double t_phase = m_tracing ? tracer.now() : 0;
+    if (m_tracing) tracer.span("delaunator::seed", t_build, t_phase - t_build, {});
+
     // sort the points by distance from the seed triangle circumcenter
-    std::sort(ids.begin(), ids.end(), compare{ coords, m_center_x, m_center_y });
+    sort_ids();
+
+    if (m_tracing) {
+        const double t = tracer.now();
+        tracer.span("delaunator::sort", t_phase, t - t_phase, {});
+        t_phase = t;
+    }
 
     // initialize a hash table for storing edges of the advancing convex hull
     m_hash_size = static_cast<std::size_t>(std::llround(std::ceil(std::sqrt(n))));
-    m_hash.resize(m_hash_size);
-    std::fill(m_hash.begin(), m_hash.end(), INVALID_INDEX);
+    m_hash.assign(m_hash_size, INVALID_INDEX);
 
     // initialize arrays for tracking the edges of the advancing convex hull
     hull_prev.resize(n);
@@ -349,13 +422,17 @@ inline Delaunator::Delaunator(std::vector<double> const& in_coords)
     m_hash[hash_key(i2x, i2y)] = i2;
 
     std::size_t max_triangles = n < 3 ? 1 : 2 * n - 5;
+    triangles.clear();
+    halfedges.clear();
     triangles.reserve(max_triangles * 3);
     halfedges.reserve(max_triangles * 3);
     add_triangle(i0, i1, i2, INVALID_INDEX, INVALID_INDEX, INVALID_INDEX);
     double xp = std::numeric_limits<double>::quiet_NaN();
     double yp = std::numeric_limits<double>::quiet_NaN();
+    std::size_t probes = 0, max_probes = 0;
+    std::size_t hull_steps = 0, max_hull_steps = 0;
     for (std::size_t k = 0; k < n; k++) {
-        const std::size_t i = ids[k];
+        const std::size_t i = m_ids[k];
         const double x = coords[2 * i];
         const double y = coords[2 * i + 1];
 
@@ -374,16 +451,21 @@ inline Delaunator::Delaunator(std::vector<double> const& in_coords)
         std::size_t start = 0;
 
         size_t key = hash_key(x, y);
-        for (size_t j = 0; j < m_hash_size; j++) {
+        size_t j = 0;
+        for (; j < m_hash_size; j++) {
             start = m_hash[fast_mod(key + j, m_hash_size)];
             if (start != INVALID_INDEX && start != hull_next[start]) break;
         }
+        probes += j + 1;
+        max_probes = std::max(max_probes, j + 1);
 
         start = hull_prev[start];
         size_t e = start;
         size_t q;
+        size_t steps = 0; // hull edges looked at for this point
 
         while (q = hull_next[e], !orient(x, y, coords[2 * e], coords[2 * e + 1], coords[2 * q], coords[2 * q + 1])) { //TODO: does it works in a same way as in JS
+            steps++;
             e = q;
             if (e == start) {
                 e = INVALID_INDEX;
@@ -416,6 +498,7 @@ inline Delaunator::Delaunator(std::vector<double> const& in_coords)
             hull_next[next] = next; // mark as removed
             hull_size--;
             next = q;
+            steps++;
         }
 
         // walk backward from the other side, adding more triangles and flipping
@@ -429,8 +512,11 @@ inline Delaunator::Delaunator(std::vector<double> const& in_coords)
                 hull_next[e] = e; // mark as removed
                 hull_size--;
                 e = q;
+                steps++;
             }
         }
+        hull_steps += steps;
+        max_hull_steps = std::max(max_hull_steps, steps);
 
         // update the hull indices
         hull_prev[i] = e;
@@ -442,9 +528,27 @@ inline Delaunator::Delaunator(std::vector<double> const& in_coords)
         m_hash[hash_key(x, y)] = i;
         m_hash[hash_key(coords[2 * e], coords[2 * e + 1])] = e;
     }
+
+    if (m_tracing) {
+        const double t = tracer.now();
+        tracer.span("delaunator::sweep", t_phase, t - t_phase, {
+            std::make_pair(std::string("legalize_us"), m_legalize_us),
+            std::make_pair(std::string("flips"), double(m_flips)),
+            std::make_pair(std::string("hash_probes"), double(probes)),
+            std::make_pair(std::string("max_hash_probes"), double(max_probes)),
+            std::make_pair(std::string("hull_steps"), double(hull_steps)),
+            std::make_pair(std::string("max_hull_steps"), double(max_hull_steps)) });
+        tracer.span("delaunator::build", t_build, t - t_build, {
+            std::make_pair(std::string("points"), double(n)),
+            std::make_pair(std::string("triangles"), double(triangles.size() / 3)),
+            std::make_pair(std::string("hull_size"), double(hull_size)) });
+    }
 }
 
 inline double Delaunator::get_hull_area() {
+    if (hull_next.empty()) {
+        throw std::runtime_error("hull was trimmed");
+    }
     std::vector<double> hull_area;
     size_t e = hull_start;
     do {
@@ -454,10 +558,45 @@ inline double Delaunator::get_hull_area() {
     return sum(hull_area);
 }
 
+inline void Delaunator::trim() {
+    std::vector<std::size_t>().swap(hull_prev);
+    std::vector<std::size_t>().swap(hull_next);
+    std::vector<std::size_t>().swap(hull_tri);
+    std::vector<std::size_t>().swap(m_hash);
+    std::vector<std::size_t>().swap(m_edge_stack);
+    std::vector<std::size_t>().swap(m_ids);
+}
+
+inline std::size_t Delaunator::construction_bytes() const {
+    return (hull_prev.capacity() + hull_next.capacity() + hull_tri.capacity() +
+            m_hash.capacity() + m_edge_stack.capacity() + m_ids.capacity()) * sizeof(std::size_t);
+}
+
+inline void Delaunator::sort_ids() {
+    compare less{ coords, m_center_x, m_center_y };
+    // compare is a total order on distinct points, so the result doesn't depend on the starting
+    // order. When the points only moved a little since the last build, most of them are already in
+    // place: try insertion sort first and give up on it after a few moves per point.
+    const std::size_t n = m_ids.size();
+    std::size_t budget = 8 * n;
+    for (std::size_t k = 1; k < n && budget > 0; k++) {
+        const std::size_t i = m_ids[k];
+        std::size_t j = k;
+        for (; j > 0 && budget > 0 && less(i, m_ids[j - 1]); j--, budget--) {
+            m_ids[j] = m_ids[j - 1];
+        }
+        m_ids[j] = i;
+    }
+    if (budget == 0) {
+        std::sort(m_ids.begin(), m_ids.end(), less);
+    }
+}
+
 inline std::size_t Delaunator::legalize(std::size_t a) {
     std::size_t i = 0;
     std::size_t ar = 0;
     m_edge_stack.clear();
+    const double t_start = m_tracing ? Tracer::global().now() : 0;
 
     // recursion eliminated with a fixed-size stack
     while (true) {
@@ -512,25 +651,7 @@ inline std::size_t Delaunator::legalize(std::size_t a) {
             coords[2 * p1 + 1]);
 
         if (illegal) {
-            triangles[a] = p1;
-            triangles[b] = p0;
-
-            auto hbl = halfedges[bl];
-
-            // edge swapped on the other side of the hull (rare); fix the halfedge reference
-            if (hbl == INVALID_INDEX) {
-                std::size_t e = hull_start;
-                do {
-                    if (hull_tri[e] == bl) {
-                        hull_tri[e] = a;
-                        break;
-                    }
-                    e = hull_next[e];
-                } while (e != hull_start);
-            }
-            link(a, hbl);
-            link(b, halfedges[ar]);
-            link(ar, bl);
+            flip(a, b);
             std::size_t br = b0 + (b + 1) % 3;
 
             if (i < m_edge_stack.size()) {
@@ -550,9 +671,88 @@ inline std::size_t Delaunator::legalize(std::size_t a) {
             }
         }
     }
+    if (m_tracing) m_legalize_us += Tracer::global().now() - t_start;
     return ar;
 }
 
+inline void Delaunator::flip(std::size_t a, std::size_t b) {
+    m_flips++;
+    const size_t a0 = 3 * (a / 3);
+    const size_t b0 = 3 * (b / 3);
+    const size_t ar = a0 + (a + 2) % 3;
+    const size_t bl = b0 + (b + 2) % 3;
+    const std::size_t p0 = triangles[ar];
+    const std::size_t p1 = triangles[bl];
+    triangles[a] = p1;
+    triangles[b] = p0;
+
+    auto hbl = halfedges[bl];
+    auto har = halfedges[ar];
+
+    // edge swapped on the other side of the hull; fix the halfedge reference.
+    // hull_tri[v] is always the hull halfedge starting at v, so triangles[bl] (= p1)
+    // is the only hull vertex that can refer to bl: no need to walk the hull.
+    // The same holds for ar and p0, which only happens outside the sweep. The hull links
+    // are gone after trim().
+    if (!hull_tri.empty()) {
+        if (hbl == INVALID_INDEX && hull_tri[p1] == bl) {
+            hull_tri[p1] = a;
+        }
+        if (har == INVALID_INDEX && hull_tri[p0] == ar) {
+            hull_tri[p0] = b;
+        }
+    }
+    link(a, hbl);
+    link(b, har);
+    link(ar, bl);
+}
+
+inline bool Delaunator::relegalize(std::vector<std::size_t>& edges, std::vector<std::size_t>& flipped) {
+    const double t_start = m_tracing ? Tracer::global().now() : 0;
+    // past this many flips a new triangulation is cheaper, and a cycle of flips between
+    // nearly cocircular points would not end
+    std::size_t budget = triangles.size() + 16;
+    bool done = true;
+    while (!edges.empty()) {
+        const std::size_t a = edges.back();
+        edges.pop_back();
+        const std::size_t b = halfedges[a];
+        if (b == INVALID_INDEX) continue;
+
+        // same quad as in legalize: a runs from pr to pl, p0 and p1 are the far corners
+        const size_t a0 = 3 * (a / 3);
+        const size_t b0 = 3 * (b / 3);
+        const size_t al = a0 + (a + 1) % 3;
+        const size_t ar = a0 + (a + 2) % 3;
+        const size_t bl = b0 + (b + 2) % 3;
+        const size_t br = b0 + (b + 1) % 3;
+        const std::size_t p0 = triangles[ar];
+        const std::size_t pr = triangles[a];
+        const std::size_t pl = triangles[al];
+        const std::size_t p1 = triangles[bl];
+        if (!in_circle(
+                coords[2 * p0], coords[2 * p0 + 1],
+                coords[2 * pr], coords[2 * pr + 1],
+                coords[2 * pl], coords[2 * pl + 1],
+                coords[2 * p1], coords[2 * p1 + 1])) continue;
+        if (budget-- == 0) {
+            done = false;
+            break;
+        }
+        flip(a, b);
+        flipped.push_back(a);
+        flipped.push_back(b);
+        // the outer edges of the quad now face the new diagonal
+        edges.push_back(a);
+        edges.push_back(al);
+        edges.push_back(b);
+        edges.push_back(br);
+    }
+    edges.clear();
+    if (m_tracing) m_legalize_us += Tracer::global().now() - t_start;
+    return done;
+}
+
 inline std::size_t Delaunator::hash_key(const double x, const double y) const {
     const double dx = x - m_center_x;
     const double dy = y - m_center_y;
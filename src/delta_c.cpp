@@ -0,0 +1,167 @@
+//  delta_c.cpp
+//  delta_xcode
+//
+//  Every entry point catches everything: no C++ exception may cross into the caller.
+//
+
+#include "delta_c.h"
+#include "Mesh.hpp"
+#include <new>
+
+struct delta_mesh
+{
+    Mesh* mesh_;
+};
+
+int delta_abi_version(void)
+{
+    return DELTA_ABI_VERSION;
+}
+
+int delta_mesh_create(const double* xy, const double* values, size_t n, delta_mesh** out)
+{
+    if (xy == NULL || values == NULL || out == NULL || n < 3) return DELTA_ERR_ARGUMENT;
+    *out = NULL;
+    delta_mesh* handle = NULL;
+    try {
+        VecDoub coords(xy, xy + 2 * n);
+        VecDoub val(values, values + n);
+        handle = new delta_mesh;
+        handle->mesh_ = new Mesh(coords, val);
+    } catch (std::bad_alloc&) {
+        delete handle;
+        return DELTA_ERR_MEMORY;
+    } catch (std::runtime_error&) {
+        delete handle;
+        return DELTA_ERR_TRIANGULATION;
+    } catch (...) {
+        delete handle;
+        return DELTA_ERR_INTERNAL;
+    }
+    *out = handle;
+    return DELTA_OK;
+}
+
+void delta_mesh_destroy(delta_mesh* mesh)
+{
+    if (mesh == NULL) return;
+    delete mesh->mesh_;
+    delete mesh;
+}
+
+int delta_mesh_size(delta_mesh* mesh, size_t* npoints, size_t* ntriangles)
+{
+    if (mesh == NULL) return DELTA_ERR_ARGUMENT;
+    if (npoints != NULL) *npoints = mesh->mesh_->size();
+    if (ntriangles != NULL) *ntriangles = mesh->mesh_->numTriag();
+    return DELTA_OK;
+}
+
+int delta_mesh_triangle_vertices(delta_mesh* mesh, const size_t* triangles, size_t n, size_t* vertices)
+{
+    if (mesh == NULL || (n > 0 && (triangles == NULL || vertices == NULL))) return DELTA_ERR_ARGUMENT;
+    size_t nt = mesh->mesh_->numTriag();
+    try {
+        for (size_t k = 0; k < n; k++){
+            if (triangles[k] / 3 >= nt) return DELTA_ERR_ARGUMENT;
+            std::vector<size_t> points = mesh->mesh_->pointsOfTriag(triangles[k]);
+            for (size_t i = 0; i < 3; i++){
+                vertices[3 * k + i] = points[2 * i] / 2;
+            }
+        }
+    } catch (std::bad_alloc&) {
+        return DELTA_ERR_MEMORY;
+    } catch (...) {
+        return DELTA_ERR_INTERNAL;
+    }
+    return DELTA_OK;
+}
+
+int delta_mesh_locate(delta_mesh* mesh, const double* xy, size_t n, size_t* triangles)
+{
+    if (mesh == NULL || (n > 0 && (xy == NULL || triangles == NULL))) return DELTA_ERR_ARGUMENT;
+    int status = DELTA_OK;
+    try {
+        size_t t = 0;
+        for (size_t k = 0; k < n; k++){
+            size_t found = mesh->mesh_->tryLocate(MeshPoint(xy[2 * k], xy[2 * k + 1]), t);
+            if (found == delaunator::INVALID_INDEX){
+                triangles[k] = DELTA_NO_TRIANGLE;
+                status = DELTA_ERR_OUTSIDE;
+            } else {
+                triangles[k] = found;
+                t = found;
+            }
+        }
+    } catch (std::bad_alloc&) {
+        return DELTA_ERR_MEMORY;
+    } catch (...) {
+        return DELTA_ERR_INTERNAL;
+    }
+    return status;
+}
+
+int delta_mesh_interp_in(delta_mesh* mesh, const double* xy, const size_t* triangles, size_t n, double* out)
+{
+    if (mesh == NULL || (n > 0 && (xy == NULL || triangles == NULL || out == NULL))) return DELTA_ERR_ARGUMENT;
+    size_t nt = mesh->mesh_->numTriag();
+    int status = DELTA_OK;
+    try {
+        for (size_t k = 0; k < n; k++){
+            if (triangles[k] == DELTA_NO_TRIANGLE){
+                out[k] = std::nan("");
+                status = DELTA_ERR_OUTSIDE;
+            } else if (triangles[k] / 3 >= nt){
+                return DELTA_ERR_ARGUMENT;
+            } else {
+                out[k] = mesh->mesh_->interpInTriag(MeshPoint(xy[2 * k], xy[2 * k + 1]), triangles[k]);
+            }
+        }
+    } catch (std::bad_alloc&) {
+        return DELTA_ERR_MEMORY;
+    } catch (...) {
+        return DELTA_ERR_INTERNAL;
+    }
+    return status;
+}
+
+int delta_mesh_interp(delta_mesh* mesh, const double* xy, size_t n, double* out)
+{
+    if (mesh == NULL || (n > 0 && (xy == NULL || out == NULL))) return DELTA_ERR_ARGUMENT;
+    int status = DELTA_OK;
+    try {
+        size_t t = 0;
+        for (size_t k = 0; k < n; k++){
+            MeshPoint p(xy[2 * k], xy[2 * k + 1]);
+            size_t found = mesh->mesh_->tryLocate(p, t);
+            if (found == delaunator::INVALID_INDEX){
+                out[k] = std::nan("");
+                status = DELTA_ERR_OUTSIDE;
+            } else {
+                out[k] = mesh->mesh_->interpInTriag(p, found);
+                t = found;
+            }
+        }
+    } catch (std::bad_alloc&) {
+        return DELTA_ERR_MEMORY;
+    } catch (...) {
+        return DELTA_ERR_INTERNAL;
+    }
+    return status;
+}
+
+int delta_mesh_get_values(delta_mesh* mesh, double* out)
+{
+    if (mesh == NULL || out == NULL) return DELTA_ERR_ARGUMENT;
+    VecDoub& val = mesh->mesh_->values();
+    std::copy(val.begin(), val.end(), out);
+    return DELTA_OK;
+}
+
+int delta_mesh_set_values(delta_mesh* mesh, const double* values)
+{
+    if (mesh == NULL || values == NULL) return DELTA_ERR_ARGUMENT;
+    VecDoub& val = mesh->mesh_->values();
+    std::copy(values, values + val.size(), val.begin());
+    return DELTA_OK;
+}
@@ -0,0 +1,118 @@
+/*  delta_c.h
+ *  delta_xcode
+ *
+ *  C interface to Mesh, built into libdelta.so
+ */
+
+#ifndef delta_c_h
+#define delta_c_h
+
+#include <stddef.h>
+
+#if defined(__GNUC__)
+#define DELTA_API __attribute__((visibility("default")))
+#else
+#define DELTA_API
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ *\brief Version of this interface; bumped only when a signature or a meaning changes
+ */
+#define DELTA_ABI_VERSION 1
+
+/**
+ *\brief Status codes returned by every call
+ */
+#define DELTA_OK               0  /**< success */
+#define DELTA_ERR_ARGUMENT     1  /**< null pointer or too few points */
+#define DELTA_ERR_OUTSIDE      2  /**< some query points are outside the domain; see the call */
+#define DELTA_ERR_TRIANGULATION 3 /**< the points can't be triangulated, e.g. all collinear */
+#define DELTA_ERR_MEMORY       4  /**< out of memory */
+#define DELTA_ERR_INTERNAL     5  /**< anything else */
+
+/**
+ *\brief Triangle index written for query points outside the domain
+ */
+#define DELTA_NO_TRIANGLE ((size_t)-1)
+
+/**
+ *\brief Opaque handle to a triangulated mesh
+ */
+typedef struct delta_mesh delta_mesh;
+
+/**
+ *\brief DELTA_ABI_VERSION of the loaded library, to check against the header
+ */
+DELTA_API int delta_abi_version(void);
+
+/**
+ *\brief Triangulates n points
+ *\param xy     Coordinates {x1, y1, x2, y2, ...}, 2 * n of them, e.g. a C-ordered (n, 2) array
+ *\param values Function values on the points, n of them
+ *\param out    Receives the handle; release it with delta_mesh_destroy
+ *\note The mesh keeps its own copy of the points and values; the caller's arrays may be freed
+ *      after the call.
+ */
+DELTA_API int delta_mesh_create(const double* xy, const double* values, size_t n, delta_mesh** out);
+
+/**
+ *\brief Frees a mesh; null is ignored
+ */
+DELTA_API void delta_mesh_destroy(delta_mesh* mesh);
+
+/**
+ *\brief Number of points and number of triangles
+ */
+DELTA_API int delta_mesh_size(delta_mesh* mesh, size_t* npoints, size_t* ntriangles);
+
+/**
+ *\brief Vertex indices of triangles
+ *\param triangles Triangle indices as returned by delta_mesh_locate, n of them
+ *\param vertices  Receives 3 * n vertex indices
+ */
+DELTA_API int delta_mesh_triangle_vertices(delta_mesh* mesh, const size_t* triangles, size_t n,
+                                           size_t* vertices);
+
+/**
+ *\brief Triangles containing n points
+ *\param xy        Query coordinates, 2 * n of them
+ *\param triangles Receives n triangle indices; DELTA_NO_TRIANGLE for points outside the domain
+ *\return DELTA_ERR_OUTSIDE if any point was outside; the others are still filled in
+ *\details Each search starts from the result of the previous point, so points sorted along a path
+ *          or a curve are located in amortized O(1).
+ */
+DELTA_API int delta_mesh_locate(delta_mesh* mesh, const double* xy, size_t n, size_t* triangles);
+
+/**
+ *\brief Linear interpolation at n points
+ *\param out Receives n values; NaN for points outside the domain
+ *\return DELTA_ERR_OUTSIDE if any point was outside; the others are still filled in
+ */
+DELTA_API int delta_mesh_interp(delta_mesh* mesh, const double* xy, size_t n, double* out);
+
+/**
+ *\brief Linear interpolation at n points whose triangles are already known; no search is done
+ *\param triangles Triangles from delta_mesh_locate; DELTA_NO_TRIANGLE gives NaN
+ */
+DELTA_API int delta_mesh_interp_in(delta_mesh* mesh, const double* xy, const size_t* triangles,
+                                   size_t n, double* out);
+
+/**
+ *\brief Copies the function values into out, npoints of them
+ */
+DELTA_API int delta_mesh_get_values(delta_mesh* mesh, double* out);
+
+/**
+ *\brief Replaces the function values, npoints of them; the triangulation is kept
+ */
+DELTA_API int delta_mesh_set_values(delta_mesh* mesh, const double* values);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* delta_c_h */